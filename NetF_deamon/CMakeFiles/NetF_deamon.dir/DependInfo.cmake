@@ -1,26 +0,0 @@
-
-# Consider dependencies only in project.
-set(CMAKE_DEPENDS_IN_PROJECT_ONLY OFF)
-
-# The set of languages for which implicit dependencies are needed:
-set(CMAKE_DEPENDS_LANGUAGES
-  )
-
-# The set of dependency files which are needed:
-set(CMAKE_DEPENDS_DEPENDENCY_FILES
-  "/home/shluha/projects/NetF_deamon/firewall.cpp" "CMakeFiles/NetF_deamon.dir/firewall.cpp.o" "gcc" "CMakeFiles/NetF_deamon.dir/firewall.cpp.o.d"
-  "/home/shluha/projects/NetF_deamon/netf_deamon.cpp" "CMakeFiles/NetF_deamon.dir/netf_deamon.cpp.o" "gcc" "CMakeFiles/NetF_deamon.dir/netf_deamon.cpp.o.d"
-  "/home/shluha/projects/NetF_deamon/trafficmonitor.cpp" "CMakeFiles/NetF_deamon.dir/trafficmonitor.cpp.o" "gcc" "CMakeFiles/NetF_deamon.dir/trafficmonitor.cpp.o.d"
-  "" "NetF_deamon" "gcc" "CMakeFiles/NetF_deamon.dir/link.d"
-  )
-
-# Targets to which this target links which contain Fortran sources.
-set(CMAKE_Fortran_TARGET_LINKED_INFO_FILES
-  )
-
-# Targets to which this target links which contain Fortran sources.
-set(CMAKE_Fortran_TARGET_FORWARD_LINKED_INFO_FILES
-  )
-
-# Fortran module output directory.
-set(CMAKE_Fortran_TARGET_MODULE_DIR "")
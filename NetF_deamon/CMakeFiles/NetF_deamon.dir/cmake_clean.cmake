@@ -1,16 +0,0 @@
-file(REMOVE_RECURSE
-  "CMakeFiles/NetF_deamon.dir/link.d"
-  "CMakeFiles/NetF_deamon.dir/firewall.cpp.o"
-  "CMakeFiles/NetF_deamon.dir/firewall.cpp.o.d"
-  "CMakeFiles/NetF_deamon.dir/netf_deamon.cpp.o"
-  "CMakeFiles/NetF_deamon.dir/netf_deamon.cpp.o.d"
-  "CMakeFiles/NetF_deamon.dir/trafficmonitor.cpp.o"
-  "CMakeFiles/NetF_deamon.dir/trafficmonitor.cpp.o.d"
-  "NetF_deamon"
-  "NetF_deamon.pdb"
-)
-
-# Per-language clean rules from dependency scanning.
-foreach(lang CXX)
-  include(CMakeFiles/NetF_deamon.dir/cmake_clean_${lang}.cmake OPTIONAL)
-endforeach()
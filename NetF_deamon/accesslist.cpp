@@ -0,0 +1,83 @@
+#include "accesslist.h"
+#include "ruletable.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+// Префиксы раскладываются от коротких к длинным: более длинный
+// перезаписывает диапазон более короткого, и в таблице остаётся
+// результат поиска самого длинного совпадения. При равной длине
+// разрешение сильнее запрета.
+accesslist::accesslist(std::vector<Entry> entries) : prefixes(entries.size()) {
+  if (entries.empty()) {
+    return;
+  }
+  std::stable_sort(entries.begin(), entries.end(),
+                   [](const Entry &a, const Entry &b) {
+                     if (a.length != b.length) {
+                       return a.length < b.length;
+                     }
+                     return a.verdict > b.verdict;
+                   });
+
+  tbl24.reset(static_cast<uint16_t *>(std::calloc(1 << 24, sizeof(uint16_t))));
+  if (!tbl24) {
+    throw std::bad_alloc();
+  }
+
+  for (const Entry &entry : entries) {
+    const uint32_t network =
+        entry.length == 0 ? 0 : entry.network & ~uint32_t(0)
+                                                    << (32 - entry.length);
+    if (entry.length <= 24) {
+      const uint32_t first = network >> 8;
+      const uint32_t span = uint32_t(1) << (24 - entry.length);
+      std::fill_n(&tbl24[first], span, uint16_t(entry.verdict));
+      continue;
+    }
+
+    uint16_t &slot = tbl24[network >> 8];
+    if (!(slot & extended)) {
+      const size_t group = tbl8.size() >> 8;
+      if (group >= extended) {
+        throw std::length_error("access list: too many prefixes over /24");
+      }
+      tbl8.resize(tbl8.size() + 256, uint8_t(slot));
+      slot = extended | group;
+    }
+    const size_t base = size_t(slot & ~extended) << 8;
+    const uint32_t first = network & 0xff;
+    const uint32_t span = uint32_t(1) << (32 - entry.length);
+    std::fill_n(&tbl8[base + first], span, uint8_t(entry.verdict));
+  }
+}
+
+bool accesslist::loadFile(const std::string &path, Verdict verdict,
+                          std::vector<Entry> &entries) {
+  std::ifstream in(path);
+  if (!in) {
+    std::cerr << "Access list: cannot open " << path << std::endl;
+    return false;
+  }
+
+  std::string line;
+  int lineno = 0;
+  while (std::getline(in, line)) {
+    ++lineno;
+    line = line.substr(0, line.find('#'));
+    size_t begin = line.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) {
+      continue;
+    }
+    size_t end = line.find_last_not_of(" \t\r");
+    SubnetRule subnet;
+    if (!ruletable::parseSubnet(line.substr(begin, end - begin + 1), subnet)) {
+      std::cerr << "Access list: " << path << ":" << lineno
+                << ": invalid prefix" << std::endl;
+      return false;
+    }
+    entries.push_back({ntohl(subnet.network), subnet.prefix, verdict});
+  }
+  return true;
+}
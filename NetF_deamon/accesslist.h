@@ -0,0 +1,61 @@
+#ifndef ACCESSLIST_H
+#define ACCESSLIST_H
+
+#include <arpa/inet.h>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class Verdict : uint8_t { NONE, ALLOW, DENY };
+
+// Списки разрешённых и запрещённых префиксов в виде DIR-24-8: старшие
+// 24 бита адреса индексируют tbl24, и только префиксы длиннее /24
+// требуют второго обращения в группу tbl8 на 256 адресов. Таблица
+// строится один раз при загрузке и дальше только читается.
+class accesslist {
+public:
+  struct Entry {
+    uint32_t network; // порядок хоста
+    uint8_t length;
+    Verdict verdict;
+  };
+
+  accesslist() = default;
+  explicit accesslist(std::vector<Entry> entries);
+
+  // Адрес в сетевом порядке; без списков таблица не выделяется
+  Verdict lookup(uint32_t ip) const {
+    if (!tbl24) {
+      return Verdict::NONE;
+    }
+    const uint32_t host = ntohl(ip);
+    uint16_t entry = tbl24[host >> 8];
+    if (entry & extended) {
+      return Verdict(tbl8[size_t(entry & ~extended) << 8 | (host & 0xff)]);
+    }
+    return Verdict(entry);
+  }
+
+  size_t size() const { return prefixes; }
+
+  // Файл: по префиксу "a.b.c.d[/len]" в строке, '#' - комментарий
+  static bool loadFile(const std::string &path, Verdict verdict,
+                       std::vector<Entry> &entries);
+
+private:
+  static constexpr uint16_t extended = 0x8000; // младшие биты - группа tbl8
+
+  struct Free {
+    void operator()(uint16_t *table) const { std::free(table); }
+  };
+
+  // 32 МБ через calloc: страницы, которых не коснулись префиксы, так и
+  // остаются нулевыми страницами ядра
+  std::unique_ptr<uint16_t[], Free> tbl24;
+  std::vector<uint8_t> tbl8;
+  size_t prefixes = 0;
+};
+
+#endif // ACCESSLIST_H
@@ -0,0 +1,111 @@
+#include "alertqueue.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+const char *attackName(AttackType type) {
+  static const char *const names[ATTACK_TYPES] = {
+      "UDP flood",           "ICMP flood",      "SYN flood",
+      "FIN flood",           "Null Scan",       "Xmas Scan",
+      "Target under attack", "Half-open flood", "Subnet attack",
+      "Port Scan",           "Host Scan",       "SSH connect flood",
+      "SSH bruteforce",
+  };
+  return type < ATTACK_TYPES ? names[type] : "Unknown attack";
+}
+
+alertqueue::alertqueue(uint32_t capacity) {
+  uint64_t size = 2;
+  while (size < capacity) {
+    size <<= 1;
+  }
+  mask = size - 1;
+  slots = std::make_unique<Slot[]>(size);
+  for (uint64_t i = 0; i < size; ++i) {
+    slots[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (event_fd < 0) {
+    // без eventfd потребитель не проснётся на алерт
+    throw std::runtime_error(std::string("alert queue: eventfd: ") +
+                             strerror(errno));
+  }
+}
+
+alertqueue::~alertqueue() {
+  if (event_fd >= 0) {
+    close(event_fd);
+  }
+}
+
+// Слот свободен для позиции pos, когда его номер равен pos; номер
+// меньше - потребитель ещё не забрал запись прошлого круга
+bool alertqueue::push(const AlertRecord &record) {
+  uint64_t pos = tail.load(std::memory_order_relaxed);
+  Slot *slot;
+  for (;;) {
+    slot = &slots[pos & mask];
+    const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+    const int64_t diff = int64_t(sequence - pos);
+    if (diff == 0) {
+      if (tail.compare_exchange_weak(pos, pos + 1,
+                                     std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      lost.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    } else {
+      pos = tail.load(std::memory_order_relaxed);
+    }
+  }
+  slot->record = record;
+  slot->sequence.store(pos + 1, std::memory_order_release);
+
+  // Пара к prepareWait: запись видна до проверки флага
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiting.load(std::memory_order_relaxed) &&
+      waiting.exchange(false, std::memory_order_acq_rel)) {
+    const uint64_t one = 1;
+    if (write(event_fd, &one, sizeof(one)) < 0) {
+      // счётчик eventfd уже взведён
+    }
+  }
+  return true;
+}
+
+size_t alertqueue::drain(AlertRecord *out, size_t max) {
+  size_t taken = 0;
+  while (taken < max) {
+    Slot &slot = slots[head & mask];
+    if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+      break; // пусто или производитель ещё пишет запись
+    }
+    out[taken++] = slot.record;
+    slot.sequence.store(head + mask + 1, std::memory_order_release);
+    ++head;
+  }
+  return taken;
+}
+
+bool alertqueue::prepareWait() {
+  waiting.store(true, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  const Slot &slot = slots[head & mask];
+  if (slot.sequence.load(std::memory_order_acquire) == head + 1) {
+    waiting.store(false, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void alertqueue::acknowledge() {
+  uint64_t value;
+  if (read(event_fd, &value, sizeof(value)) < 0) {
+    // не взведён: проснулись по таймауту или другому дескриптору
+  }
+  waiting.store(false, std::memory_order_relaxed);
+}
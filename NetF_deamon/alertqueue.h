@@ -0,0 +1,85 @@
+#ifndef ALERTQUEUE_H
+#define ALERTQUEUE_H
+
+#include "detectorset.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+// Типы алертов. Первые FLOOD_KINDS совпадают с FloodKind. Значения уходят
+// в D-Bus (AttacksDetected), новые типы добавляются только в конец.
+enum AttackType : uint8_t {
+  ATTACK_UDP_FLOOD,
+  ATTACK_ICMP_FLOOD,
+  ATTACK_SYN_FLOOD,
+  ATTACK_FIN_FLOOD,
+  ATTACK_NULL_SCAN,
+  ATTACK_XMAS_SCAN,
+  ATTACK_TARGET,    // флуд на адрес назначения
+  ATTACK_HALF_OPEN, // недостроенные рукопожатия на адрес и порт
+  ATTACK_SUBNET,    // свёрнутый префикс атакующих
+  ATTACK_PORT_SCAN, // вертикальный скан
+  ATTACK_HOST_SCAN, // горизонтальный скан
+  ATTACK_SSH_CONNECT,
+  ATTACK_SSH_BRUTEFORCE,
+  ATTACK_TYPES,
+};
+static_assert(int(ATTACK_XMAS_SCAN) == FLOOD_XMAS && FLOOD_KINDS == 6,
+              "flood attack types must follow FloodKind");
+
+const char *attackName(AttackType type);
+
+// Алерт фиксированного размера: воркер не аллоцирует и не форматирует
+struct AlertRecord {
+  uint32_t ip;        // сетевой порядок
+  uint32_t count;
+  uint32_t timestamp; // секунды
+  AttackType type;
+  uint8_t length;     // длина префикса, 32 - адрес
+  bool target;        // ip - адрес жертвы, а не источника
+  uint8_t reserved;
+};
+static_assert(sizeof(AlertRecord) == 16, "AlertRecord must stay compact");
+
+// Ограниченная MPSC-очередь алертов от воркеров к главному циклу (схема
+// Вьюкова: у слота номер последовательности, производители делят хвост
+// через CAS). Переполненная очередь теряет алерт и учитывает его в
+// dropped(). Потребитель перед сном взводит eventfd через prepareWait:
+// производитель пишет в него, только если потребитель спит, так что
+// поток алертов не превращается в поток системных вызовов.
+class alertqueue {
+public:
+  // capacity округляется до 2^n; без eventfd - std::runtime_error
+  explicit alertqueue(uint32_t capacity = 4096);
+  ~alertqueue();
+  alertqueue(const alertqueue &) = delete;
+  alertqueue &operator=(const alertqueue &) = delete;
+
+  bool push(const AlertRecord &record); // любой поток
+  // Только потребитель: до max записей, возвращает их число
+  size_t drain(AlertRecord *out, size_t max);
+
+  int fd() const { return event_fd; } // для poll, POLLIN
+  // Потребитель перед poll: false - ждать нельзя, очередь не пуста
+  bool prepareWait();
+  void acknowledge(); // после пробуждения: сбросить eventfd
+
+  uint64_t dropped() const { return lost.load(std::memory_order_relaxed); }
+  size_t capacity() const { return mask + 1; }
+
+private:
+  struct Slot {
+    std::atomic<uint64_t> sequence;
+    AlertRecord record;
+  };
+
+  std::unique_ptr<Slot[]> slots;
+  uint64_t mask;
+  int event_fd;
+  alignas(64) std::atomic<uint64_t> tail{0}; // делят производители
+  alignas(64) uint64_t head = 0;             // только потребитель
+  alignas(64) std::atomic<bool> waiting{false};
+  std::atomic<uint64_t> lost{0};
+};
+
+#endif // ALERTQUEUE_H
@@ -0,0 +1,91 @@
+#include "bpfprefilter.h"
+#include "detectorset.h"
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+// Метки переходов до финальных ret. Программа короче 0xfe инструкций,
+// поэтому эти значения не пересекаются с реальными смещениями.
+static constexpr uint8_t JUMP_ACCEPT = 0xfe;
+static constexpr uint8_t JUMP_REJECT = 0xff;
+
+static struct sock_filter stmt(uint16_t code, uint32_t k) {
+  return BPF_STMT(code, k);
+}
+
+static struct sock_filter jump(uint16_t code, uint32_t k, uint8_t jt,
+                               uint8_t jf) {
+  return BPF_JUMP(code, k, jt, jf);
+}
+
+std::vector<struct sock_filter> bpfprefilter::build(uint32_t detectors,
+                                                    uint32_t snaplen) {
+  std::vector<struct sock_filter> code;
+  const uint32_t tcp_detectors = DETECT_SYN_FLOOD | DETECT_FIN_FLOOD |
+                                 DETECT_NULL_SCAN | DETECT_XMAS_SCAN |
+                                 DETECT_PORT_SCAN | DETECT_SSH | DETECT_TARGET;
+
+  // Ethernet + IPv4
+  code.push_back(stmt(BPF_LD | BPF_H | BPF_ABS, 12));
+  code.push_back(jump(BPF_JMP | BPF_JEQ | BPF_K, 0x0800, 0, JUMP_REJECT));
+  code.push_back(stmt(BPF_LD | BPF_B | BPF_ABS, 23));
+
+  if (detectors & (DETECT_UDP_FLOOD | DETECT_TARGET)) {
+    code.push_back(
+        jump(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, JUMP_ACCEPT, 0));
+  }
+  if (detectors & (DETECT_ICMP_FLOOD | DETECT_TARGET)) {
+    code.push_back(
+        jump(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_ICMP, JUMP_ACCEPT, 0));
+  }
+
+  if (detectors & DETECT_HALF_OPEN) {
+    // Трекеру потоков нужны ответы серверов и ACK клиентов, то есть
+    // весь TCP: остальные проверки ничего бы не отсеяли
+    code.push_back(
+        jump(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_TCP, JUMP_ACCEPT, JUMP_REJECT));
+  } else if (detectors & tcp_detectors) {
+    code.push_back(
+        jump(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_TCP, 0, JUMP_REJECT));
+    // Не первые фрагменты не несут TCP-заголовка
+    code.push_back(stmt(BPF_LD | BPF_H | BPF_ABS, 20));
+    code.push_back(jump(BPF_JMP | BPF_JSET | BPF_K, 0x1fff, JUMP_REJECT, 0));
+    code.push_back(stmt(BPF_LDX | BPF_B | BPF_MSH, 14));
+
+    if (detectors & DETECT_SSH) {
+      code.push_back(stmt(BPF_LD | BPF_H | BPF_IND, 14 + 2));
+      code.push_back(jump(BPF_JMP | BPF_JEQ | BPF_K, 22, JUMP_ACCEPT, 0));
+    }
+
+    const uint32_t ackless = DETECT_SYN_FLOOD | DETECT_NULL_SCAN |
+                             DETECT_XMAS_SCAN | DETECT_PORT_SCAN |
+                             DETECT_TARGET;
+    if (detectors & (ackless | DETECT_FIN_FLOOD)) {
+      code.push_back(stmt(BPF_LD | BPF_B | BPF_IND, 14 + 13));
+    }
+    if (detectors & ackless) {
+      code.push_back(jump(BPF_JMP | BPF_JSET | BPF_K, TH_ACK, 0, JUMP_ACCEPT));
+    }
+    if (detectors & DETECT_FIN_FLOOD) {
+      code.push_back(jump(BPF_JMP | BPF_JSET | BPF_K, TH_FIN, JUMP_ACCEPT, 0));
+    }
+  }
+
+  const uint32_t reject = code.size();
+  code.push_back(stmt(BPF_RET | BPF_K, 0));
+  const uint32_t accept = code.size();
+  code.push_back(stmt(BPF_RET | BPF_K, snaplen));
+
+  for (uint32_t i = 0; i < reject; ++i) {
+    if (BPF_CLASS(code[i].code) != BPF_JMP) {
+      continue;
+    }
+    for (uint8_t *target : {&code[i].jt, &code[i].jf}) {
+      if (*target == JUMP_ACCEPT) {
+        *target = accept - i - 1;
+      } else if (*target == JUMP_REJECT) {
+        *target = reject - i - 1;
+      }
+    }
+  }
+  return code;
+}
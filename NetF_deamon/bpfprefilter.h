@@ -0,0 +1,18 @@
+#ifndef BPFPREFILTER_H
+#define BPFPREFILTER_H
+
+#include <cstdint>
+#include <linux/filter.h>
+#include <vector>
+
+// Генератор классического BPF-фильтра по набору включённых детекторов.
+// Фильтр пропускает только то, что firewall реально разбирает: UDP, ICMP
+// и TCP-сегменты без ACK (SYN/Null/Xmas и сканы), FIN и трафик на 22 порт.
+// Установленный TCP-трафик с данными остаётся в ядре.
+class bpfprefilter {
+public:
+  static std::vector<struct sock_filter> build(uint32_t detectors,
+                                               uint32_t snaplen);
+};
+
+#endif // BPFPREFILTER_H
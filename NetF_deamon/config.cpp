@@ -0,0 +1,367 @@
+#include "config.h"
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+static std::string trim(const std::string &s) {
+  size_t begin = s.find_first_not_of(" \t\r");
+  if (begin == std::string::npos) {
+    return "";
+  }
+  size_t end = s.find_last_not_of(" \t\r");
+  return s.substr(begin, end - begin + 1);
+}
+
+static std::string stripComment(const std::string &line) {
+  bool quoted = false;
+  for (size_t i = 0; i < line.size(); ++i) {
+    if (line[i] == '"') {
+      quoted = !quoted;
+    } else if (line[i] == '#' && !quoted) {
+      return line.substr(0, i);
+    }
+  }
+  return line;
+}
+
+bool config::parse(const std::string &path, Sections &sections,
+                   std::string &error) {
+  std::ifstream in(path);
+  if (!in) {
+    error = "cannot open " + path;
+    return false;
+  }
+
+  std::string line;
+  std::string current;
+  int lineno = 0;
+  while (std::getline(in, line)) {
+    ++lineno;
+    line = trim(stripComment(line));
+    if (line.empty()) {
+      continue;
+    }
+
+    if (line.front() == '[') {
+      if (line.back() != ']') {
+        error = path + ":" + std::to_string(lineno) + ": unterminated section";
+        return false;
+      }
+      current = trim(line.substr(1, line.size() - 2));
+      sections[current];
+      continue;
+    }
+
+    size_t eq = line.find('=');
+    if (eq == std::string::npos) {
+      error = path + ":" + std::to_string(lineno) + ": expected key = value";
+      return false;
+    }
+
+    std::string key = trim(line.substr(0, eq));
+    std::string value = trim(line.substr(eq + 1));
+    if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+      value = value.substr(1, value.size() - 2);
+    }
+    sections[current][key] = value;
+  }
+  return true;
+}
+
+bool config::getUInt(const Section &section, const std::string &key,
+                     uint32_t &value) {
+  auto it = section.find(key);
+  if (it == section.end()) {
+    return false;
+  }
+  try {
+    size_t used = 0;
+    unsigned long parsed = std::stoul(it->second, &used, 0);
+    if (used != it->second.size() || parsed > UINT32_MAX) {
+      throw std::out_of_range(key);
+    }
+    value = parsed;
+    return true;
+  } catch (const std::exception &) {
+    std::cerr << "Config: invalid number for " << key << ": " << it->second
+              << std::endl;
+    return false;
+  }
+}
+
+bool config::getBool(const Section &section, const std::string &key,
+                     bool &value) {
+  auto it = section.find(key);
+  if (it == section.end()) {
+    return false;
+  }
+  if (it->second == "true") {
+    value = true;
+  } else if (it->second == "false") {
+    value = false;
+  } else {
+    std::cerr << "Config: invalid boolean for " << key << ": " << it->second
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool config::getString(const Section &section, const std::string &key,
+                       std::string &value) {
+  auto it = section.find(key);
+  if (it == section.end()) {
+    return false;
+  }
+  value = it->second;
+  return true;
+}
+
+bool config::load(const std::string &path, DaemonConfig &out) {
+  Sections sections;
+  std::string error;
+  if (!parse(path, sections, error)) {
+    std::cerr << "Config: " << error << std::endl;
+    return false;
+  }
+
+  const Section &capture = sections["capture"];
+  getString(capture, "interface", out.capture.interface);
+  getString(capture, "backend", out.capture.backend);
+  getUInt(capture, "block_size", out.capture.block_size);
+  getUInt(capture, "frame_size", out.capture.frame_size);
+  getUInt(capture, "frame_count", out.capture.frame_count);
+  getUInt(capture, "block_timeout_ms", out.capture.block_timeout_ms);
+  getUInt(capture, "workers", out.capture.workers);
+  getUInt(capture, "fanout_group", out.capture.fanout_group);
+  getUInt(capture, "snaplen", out.capture.snaplen);
+  getUInt(capture, "buffer_size", out.capture.buffer_size);
+  getUInt(capture, "pcap_timeout_ms", out.capture.pcap_timeout_ms);
+  getBool(capture, "immediate_mode", out.capture.immediate_mode);
+  getBool(capture, "prefilter", out.capture.prefilter);
+  getString(capture, "clock", out.capture.clock);
+
+  const Section &logging = sections["logging"];
+  getString(logging, "level", out.logging.level);
+  getString(logging, "sink", out.logging.sink);
+  getString(logging, "file", out.logging.file);
+
+  const Section &limits = sections["limits"];
+  uint32_t memory_mb = 0;
+  if (getUInt(limits, "memory_mb", memory_mb)) {
+    out.detection.memory_budget = uint64_t(memory_mb) << 20;
+  }
+  getUInt(limits, "max_sources", out.detection.max_sources);
+  getUInt(limits, "max_scans", out.detection.max_scans);
+  getUInt(limits, "block_ttl", out.detection.block_ttl);
+  getUInt(limits, "max_blocked", out.detection.max_blocked);
+  getUInt(limits, "max_targets", out.detection.max_targets);
+  getUInt(limits, "max_flows", out.detection.max_flows);
+  getUInt(limits, "alert_queue", out.detection.alert_queue);
+  getUInt(limits, "handshake_timeout", out.detection.handshake_timeout);
+  getUInt(limits, "flow_timeout", out.detection.flow_timeout);
+
+  const Section &flood = sections["flood"];
+  getString(flood, "mode", out.detection.flood_mode);
+  getUInt(flood, "sketch_width", out.detection.sketch_width);
+  getUInt(flood, "sketch_depth", out.detection.sketch_depth);
+  getUInt(flood, "top_k", out.detection.top_k);
+  getUInt(flood, "volume", out.detection.flood_volume);
+  getUInt(flood, "kernel_entries", out.detection.kernel_entries);
+  if (out.detection.flood_mode != "exact" &&
+      out.detection.flood_mode != "sketch" &&
+      out.detection.flood_mode != "kernel") {
+    std::cerr << "Config: unknown flood mode " << out.detection.flood_mode
+              << std::endl;
+    return false;
+  }
+  if (out.detection.kernel_entries == 0) {
+    std::cerr << "Config: flood kernel_entries must be non-zero"
+              << std::endl;
+    return false;
+  }
+
+  const Section &aggregate = sections["aggregate"];
+  getBool(aggregate, "enabled", out.aggregate.enabled);
+  std::string levels;
+  if (getString(aggregate, "levels", levels) &&
+      !AggregateConfig::parseLevels(levels, out.aggregate.levels)) {
+    std::cerr << "Config: invalid aggregate levels " << levels << std::endl;
+    return false;
+  }
+
+  const Section &mitigation = sections["mitigation"];
+  getBool(mitigation, "enabled", out.mitigation.enabled);
+  getString(mitigation, "table", out.mitigation.table);
+  getString(mitigation, "set", out.mitigation.set);
+  getUInt(mitigation, "timeout", out.mitigation.timeout);
+  getUInt(mitigation, "batch", out.mitigation.batch);
+  getUInt(mitigation, "flush_ms", out.mitigation.flush_ms);
+  getBool(mitigation, "drop", out.mitigation.drop);
+  getBool(mitigation, "keep_on_exit", out.mitigation.keep_on_exit);
+  getUInt(mitigation, "min_prefix", out.mitigation.min_prefix);
+  if (!MitigationConfig::validName(out.mitigation.table) ||
+      !MitigationConfig::validName(out.mitigation.set)) {
+    std::cerr << "Config: nftables table and set names must be "
+                 "alphanumeric"
+              << std::endl;
+    return false;
+  }
+  if (out.mitigation.batch == 0) {
+    std::cerr << "Config: mitigation batch must be non-zero" << std::endl;
+    return false;
+  }
+  if (out.mitigation.min_prefix == 0 || out.mitigation.min_prefix > 32) {
+    std::cerr << "Config: mitigation min_prefix must be 1..32" << std::endl;
+    return false;
+  }
+  if (out.mitigation.timeout == 0) {
+    out.mitigation.timeout = out.detection.block_ttl;
+  }
+
+  const Section &xdp = sections["xdp"];
+  getBool(xdp, "enabled", out.xdp.enabled);
+  getString(xdp, "mode", out.xdp.mode);
+  getUInt(xdp, "max_entries", out.xdp.max_entries);
+  if (out.xdp.mode != "generic" && out.xdp.mode != "native") {
+    std::cerr << "Config: unknown XDP mode " << out.xdp.mode << std::endl;
+    return false;
+  }
+  if (out.xdp.max_entries == 0) {
+    std::cerr << "Config: xdp max_entries must be non-zero" << std::endl;
+    return false;
+  }
+
+  const Section &incidents = sections["incidents"];
+  getUInt(incidents, "update_interval", out.incidents.update_interval);
+  getUInt(incidents, "close_after", out.incidents.close_after);
+  getUInt(incidents, "max_incidents", out.incidents.max_incidents);
+  if (out.incidents.close_after == 0) {
+    std::cerr << "Config: incidents close_after must be non-zero"
+              << std::endl;
+    return false;
+  }
+
+  return loadRules(sections, out);
+}
+
+// Ключи порогов флуда совпадают с ключами детекторов в [detectors]
+bool config::loadThresholds(const Section &section, Thresholds &thresholds) {
+  for (int kind = 0; kind < FLOOD_KINDS; ++kind) {
+    getUInt(section, detectorKey(flood_detectors[kind]),
+            thresholds.flood[kind]);
+  }
+  getUInt(section, "flood_window_ms", thresholds.flood_window_ms);
+  getUInt(section, "scan_ports", thresholds.scan_ports);
+  getUInt(section, "scan_hosts", thresholds.scan_hosts);
+  getUInt(section, "scan_window", thresholds.scan_window);
+  getUInt(section, "ssh_connect", thresholds.ssh_connect);
+  getUInt(section, "ssh_bruteforce", thresholds.ssh_bruteforce);
+  getUInt(section, "ssh_window", thresholds.ssh_window);
+  getUInt(section, "target_packets", thresholds.target_packets);
+  getUInt(section, "target_sources", thresholds.target_sources);
+  getUInt(section, "half_open", thresholds.half_open);
+  getUInt(section, "min_completion", thresholds.min_completion);
+  if (thresholds.flood_window_ms == 0 || thresholds.scan_window == 0 ||
+      thresholds.ssh_window == 0) {
+    std::cerr << "Config: detector windows must be non-zero" << std::endl;
+    return false;
+  }
+  if (thresholds.min_completion > 100) {
+    std::cerr << "Config: min_completion is a percentage" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void config::loadDetectors(const Section &section, uint32_t &detectors) {
+  for (const auto &entry : detector_names) {
+    bool enabled = detectors & entry.detector;
+    getBool(section, entry.key, enabled);
+    if (enabled) {
+      detectors |= entry.detector;
+    } else {
+      detectors &= ~entry.detector;
+    }
+  }
+}
+
+// Переопределения для подсети наследуют умолчания и меняют только
+// указанные ключи:
+//   [overrides."10.0.0.0/8".thresholds]
+//   [overrides."10.0.0.0/8".detectors]
+// Списки [lists] allow/deny компилируются в ту же таблицу.
+bool config::loadRules(Sections &sections, DaemonConfig &out) {
+  static const std::string prefix = "overrides.";
+
+  Rule defaults;
+  if (!loadThresholds(sections["thresholds"], defaults.thresholds)) {
+    return false;
+  }
+  loadDetectors(sections["detectors"], defaults.detectors);
+
+  std::map<std::string, SubnetRule> subnets;
+  for (const auto &[name, section] : sections) {
+    if (name.compare(0, prefix.size(), prefix) != 0) {
+      continue;
+    }
+    size_t dot = name.rfind('.');
+    std::string subnet = name.substr(prefix.size(), dot - prefix.size());
+    std::string kind = name.substr(dot + 1);
+    if (subnet.size() >= 2 && subnet.front() == '"' && subnet.back() == '"') {
+      subnet = subnet.substr(1, subnet.size() - 2);
+    }
+
+    auto [it, inserted] = subnets.try_emplace(subnet);
+    SubnetRule &rule = it->second;
+    if (inserted) {
+      if (!ruletable::parseSubnet(subnet, rule)) {
+        std::cerr << "Config: invalid subnet in [" << name << "]"
+                  << std::endl;
+        return false;
+      }
+      rule.rule = defaults;
+    }
+
+    if (kind == "thresholds") {
+      if (!loadThresholds(section, rule.rule.thresholds)) {
+        return false;
+      }
+    } else if (kind == "detectors") {
+      loadDetectors(section, rule.rule.detectors);
+    } else {
+      std::cerr << "Config: unknown section [" << name << "]" << std::endl;
+      return false;
+    }
+  }
+
+  std::vector<SubnetRule> overrides;
+  for (const auto &[name, rule] : subnets) {
+    overrides.push_back(rule);
+  }
+
+  const Section &lists = sections["lists"];
+  std::vector<accesslist::Entry> listed;
+  std::string path;
+  if (getString(lists, "allow", path) && !path.empty() &&
+      !accesslist::loadFile(path, Verdict::ALLOW, listed)) {
+    return false;
+  }
+  if (getString(lists, "deny", path) && !path.empty() &&
+      !accesslist::loadFile(path, Verdict::DENY, listed)) {
+    return false;
+  }
+
+  // Слишком много префиксов длиннее /24 или нехватка памяти под
+  // таблицы - ошибка конфига, а не падение демона
+  try {
+    out.rules = std::make_shared<const ruletable>(
+        defaults, std::move(overrides), accesslist(std::move(listed)));
+  } catch (const std::exception &e) {
+    std::cerr << "Config: cannot build access lists: " << e.what()
+              << std::endl;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,55 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include "detectorset.h"
+#include "firewall.h"
+#include "incidenttable.h"
+#include "logger.h"
+#include "nftmitigator.h"
+#include "packetcapture.h"
+#include "prefixaggregator.h"
+#include "ruletable.h"
+#include "xdpblocklist.h"
+#include <map>
+#include <memory>
+#include <string>
+
+struct DaemonConfig {
+  CaptureConfig capture;
+  LogConfig logging;
+  DetectorConfig detection;
+  AggregateConfig aggregate;
+  MitigationConfig mitigation;
+  XdpConfig xdp;
+  IncidentConfig incidents;
+  // Пороги и детекторы из [thresholds], [detectors] и
+  // [overrides."подсеть".*], скомпилированные в таблицу правил
+  std::shared_ptr<const ruletable> rules =
+      std::make_shared<const ruletable>();
+};
+
+// Конфиг демона - подмножество TOML: [секции], key = value, строки в
+// кавычках, целые числа, true/false и комментарии через '#'.
+class config {
+public:
+  using Section = std::map<std::string, std::string>;
+  using Sections = std::map<std::string, Section>;
+
+  static bool parse(const std::string &path, Sections &sections,
+                    std::string &error);
+  static bool load(const std::string &path, DaemonConfig &out);
+
+  static bool getUInt(const Section &section, const std::string &key,
+                      uint32_t &value);
+  static bool getBool(const Section &section, const std::string &key,
+                      bool &value);
+  static bool getString(const Section &section, const std::string &key,
+                        std::string &value);
+
+private:
+  static bool loadRules(Sections &sections, DaemonConfig &out);
+  static bool loadThresholds(const Section &section, Thresholds &thresholds);
+  static void loadDetectors(const Section &section, uint32_t &detectors);
+};
+
+#endif // CONFIG_H
@@ -0,0 +1,66 @@
+#ifndef DETECTORCLOCK_H
+#define DETECTORCLOCK_H
+
+#include "packetbatch.h"
+#include <cstdint>
+#include <ctime>
+#include <sys/time.h>
+
+// Время детекторов в микросекундах от эпохи: окна считаются с точностью
+// ниже секунды, без шагов time(nullptr).
+using EventTime = int64_t;
+
+constexpr EventTime USEC_PER_SEC = 1000000;
+
+inline EventTime toEventTime(const struct timeval &ts) {
+  return EventTime(ts.tv_sec) * USEC_PER_SEC + ts.tv_usec;
+}
+
+inline time_t toUnixTime(EventTime t) { return t / USEC_PER_SEC; }
+
+// Часы, по которым детекторы считают окна. now() обновляется не чаще
+// одного раза на пакет и не требует системных вызовов.
+class detectorclock {
+public:
+  virtual ~detectorclock() = default;
+
+  virtual void beginBatch(const PacketBatch &batch) = 0;
+  virtual void observe(const struct pcap_pkthdr *header) = 0;
+
+  EventTime now() const { return current; }
+
+protected:
+  EventTime current = 0;
+};
+
+// Время пакетов с монотонной отметкой: переупорядоченные пакеты не
+// отматывают часы назад. Для replay и тестов - результат детерминирован.
+class eventclock : public detectorclock {
+public:
+  void beginBatch(const PacketBatch &) override {}
+  void observe(const struct pcap_pkthdr *header) override {
+    EventTime t = toEventTime(header->ts);
+    if (t > current) {
+      current = t;
+    }
+  }
+};
+
+// Для живого захвата: CLOCK_REALTIME_COARSE через vDSO раз на пачку,
+// точность - тик ядра, на пакет ничего не тратится.
+class coarseclock : public detectorclock {
+public:
+  coarseclock() { refresh(); }
+
+  void beginBatch(const PacketBatch &) override { refresh(); }
+  void observe(const struct pcap_pkthdr *) override {}
+
+private:
+  void refresh() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    current = EventTime(ts.tv_sec) * USEC_PER_SEC + ts.tv_nsec / 1000;
+  }
+};
+
+#endif // DETECTORCLOCK_H
@@ -0,0 +1,62 @@
+#ifndef DETECTORPIPELINE_H
+#define DETECTORPIPELINE_H
+
+#include "detectorclock.h"
+#include <concepts>
+#include <cstdint>
+#include <netinet/in.h>
+
+// Разобранные заголовки пакета, общие для всех детекторов. Поля TCP
+// заполнены, только если protocol == IPPROTO_TCP: усечённый TCP-пакет
+// до детекторов не доходит. Порты есть и у UDP, если заголовок целиком
+// попал в снимок, иначе 0.
+struct PacketView {
+  uint32_t src_ip; // сетевой порядок
+  uint32_t dst_ip;
+  uint8_t protocol;
+  uint8_t tcp_flags;
+  uint16_t sport; // порядок хоста
+  uint16_t dport;
+  EventTime now;
+
+  bool isTcp() const { return protocol == IPPROTO_TCP; }
+};
+
+// Детектор - тип без состояния: бит в маске Detector, дешёвая проверка
+// заголовков и обработка пакета через контекст, который даёт доступ к
+// состоянию источника. Само состояние живёт в firewall.
+template <typename T, typename Context>
+concept PacketDetector = requires(Context &context, const PacketView &packet) {
+  { T::id } -> std::convertible_to<uint32_t>;
+  { T::matches(packet) } -> std::same_as<bool>;
+  { T::inspect(context, packet) } -> std::same_as<void>;
+};
+
+// Конвейер собирается из списка типов на этапе компиляции: проверки
+// разворачиваются в последовательность встроенных if без виртуальных
+// вызовов. Детекторы вне BuildMask выпадают из кода целиком.
+template <uint32_t BuildMask, typename... Detectors> class detectorpipeline {
+public:
+  static constexpr uint32_t mask =
+      (uint32_t(0) | ... | (uint32_t(Detectors::id) & BuildMask));
+
+  template <typename Context>
+    requires(PacketDetector<Detectors, Context> && ...)
+  static void run(uint32_t enabled, Context &context,
+                  const PacketView &packet) {
+    (dispatch<Detectors>(enabled, context, packet), ...);
+  }
+
+private:
+  template <typename D, typename Context>
+  static void dispatch(uint32_t enabled, Context &context,
+                       const PacketView &packet) {
+    if constexpr ((uint32_t(D::id) & BuildMask) != 0) {
+      if ((enabled & D::id) && D::matches(packet)) {
+        D::inspect(context, packet);
+      }
+    }
+  }
+};
+
+#endif // DETECTORPIPELINE_H
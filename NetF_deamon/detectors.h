@@ -0,0 +1,143 @@
+#ifndef DETECTORS_H
+#define DETECTORS_H
+
+#include "detectorpipeline.h"
+#include "detectorset.h"
+#include <netinet/tcp.h>
+
+// Детекторы, собранные в сборке. Ненужные можно выключить при
+// конфигурации: -DNETF_BUILD_DETECTORS="DETECT_SYN_FLOOD|DETECT_SSH".
+#ifndef NETF_BUILD_DETECTORS
+#define NETF_BUILD_DETECTORS DETECT_ALL
+#endif
+
+// Флуд-детекторы отличаются только типом счётчика и условием на
+// заголовки; порог за окно берётся из правила источника (ruletable.h),
+// тип алерта совпадает с типом счётчика (alertqueue.h)
+template <typename Self> struct FloodDetector {
+  template <typename Context>
+  static void inspect(Context &context, const PacketView &) {
+    context.flood(Self::kind);
+  }
+};
+
+struct UdpFlood : FloodDetector<UdpFlood> {
+  static constexpr Detector id = DETECT_UDP_FLOOD;
+  static constexpr FloodKind kind = FLOOD_UDP;
+
+  static bool matches(const PacketView &packet) {
+    return packet.protocol == IPPROTO_UDP;
+  }
+};
+
+struct IcmpFlood : FloodDetector<IcmpFlood> {
+  static constexpr Detector id = DETECT_ICMP_FLOOD;
+  static constexpr FloodKind kind = FLOOD_ICMP;
+
+  static bool matches(const PacketView &packet) {
+    return packet.protocol == IPPROTO_ICMP;
+  }
+};
+
+// Сканы - это пробы без ACK; согласовано с bpfprefilter
+struct PortScan {
+  static constexpr Detector id = DETECT_PORT_SCAN;
+
+  static bool matches(const PacketView &packet) {
+    return packet.isTcp() && !(packet.tcp_flags & TH_ACK);
+  }
+  template <typename Context>
+  static void inspect(Context &context, const PacketView &) {
+    context.portScan();
+  }
+};
+
+struct SshGuard {
+  static constexpr Detector id = DETECT_SSH;
+
+  static bool matches(const PacketView &packet) {
+    return packet.isTcp() && packet.dport == 22;
+  }
+  template <typename Context>
+  static void inspect(Context &context, const PacketView &) {
+    context.ssh();
+  }
+};
+
+struct SynFlood : FloodDetector<SynFlood> {
+  static constexpr Detector id = DETECT_SYN_FLOOD;
+  static constexpr FloodKind kind = FLOOD_SYN;
+
+  static bool matches(const PacketView &packet) {
+    return packet.isTcp() && (packet.tcp_flags & TH_SYN) &&
+           !(packet.tcp_flags & TH_ACK);
+  }
+};
+
+struct XmasScan : FloodDetector<XmasScan> {
+  static constexpr Detector id = DETECT_XMAS_SCAN;
+  static constexpr FloodKind kind = FLOOD_XMAS;
+
+  static bool matches(const PacketView &packet) {
+    uint8_t flags = packet.tcp_flags;
+    return packet.isTcp() && (flags & TH_FIN) && (flags & TH_URG) &&
+           (flags & TH_PUSH) && !(flags & TH_SYN) && !(flags & TH_ACK);
+  }
+};
+
+struct FinFlood : FloodDetector<FinFlood> {
+  static constexpr Detector id = DETECT_FIN_FLOOD;
+  static constexpr FloodKind kind = FLOOD_FIN;
+
+  static bool matches(const PacketView &packet) {
+    return packet.isTcp() && (packet.tcp_flags & TH_FIN) &&
+           !(packet.tcp_flags & TH_SYN);
+  }
+};
+
+struct NullScan : FloodDetector<NullScan> {
+  static constexpr Detector id = DETECT_NULL_SCAN;
+  static constexpr FloodKind kind = FLOOD_NULL;
+
+  static bool matches(const PacketView &packet) {
+    return packet.isTcp() &&
+           (packet.tcp_flags & (TH_SYN | TH_ACK | TH_FIN | TH_RST)) == 0;
+  }
+};
+
+// Учёт на стороне жертвы: UDP, ICMP и попытки TCP-соединений всех
+// источников суммируются по адресу и порту назначения
+struct TargetGuard {
+  static constexpr Detector id = DETECT_TARGET;
+
+  static bool matches(const PacketView &packet) {
+    if (packet.isTcp()) {
+      return (packet.tcp_flags & TH_SYN) && !(packet.tcp_flags & TH_ACK);
+    }
+    return true;
+  }
+  template <typename Context>
+  static void inspect(Context &context, const PacketView &) {
+    context.target();
+  }
+};
+
+// Рукопожатия TCP по таблице потоков: доля завершённых на адрес и порт
+// назначения
+struct HalfOpenGuard {
+  static constexpr Detector id = DETECT_HALF_OPEN;
+
+  static bool matches(const PacketView &packet) { return packet.isTcp(); }
+  template <typename Context>
+  static void inspect(Context &context, const PacketView &) {
+    context.flow();
+  }
+};
+
+// Порядок - как в прежнем analyzePacket: от него зависит порядок алертов
+using DetectorPipeline =
+    detectorpipeline<NETF_BUILD_DETECTORS, UdpFlood, IcmpFlood, PortScan,
+                     SshGuard, SynFlood, XmasScan, FinFlood, NullScan,
+                     TargetGuard, HalfOpenGuard>;
+
+#endif // DETECTORS_H
@@ -0,0 +1,62 @@
+#ifndef DETECTORSET_H
+#define DETECTORSET_H
+
+#include <cstdint>
+
+// Битовая маска включённых детекторов. Из неё firewall решает, что
+// считать, а bpfprefilter - какие пакеты вообще поднимать из ядра.
+enum Detector : uint32_t {
+  DETECT_UDP_FLOOD = 1u << 0,
+  DETECT_ICMP_FLOOD = 1u << 1,
+  DETECT_SYN_FLOOD = 1u << 2,
+  DETECT_FIN_FLOOD = 1u << 3,
+  DETECT_NULL_SCAN = 1u << 4,
+  DETECT_XMAS_SCAN = 1u << 5,
+  DETECT_PORT_SCAN = 1u << 6,
+  DETECT_SSH = 1u << 7,
+  DETECT_TARGET = 1u << 8,    // суммарный флуд на адрес назначения
+  DETECT_HALF_OPEN = 1u << 9, // недостроенные TCP-рукопожатия
+  DETECT_ALL = (1u << 10) - 1,
+};
+
+// Флуд-детекторы считают пакеты в общих для них структурах (запись
+// источника или скетч), по счётчику на тип
+enum FloodKind : uint8_t {
+  FLOOD_UDP,
+  FLOOD_ICMP,
+  FLOOD_SYN,
+  FLOOD_FIN,
+  FLOOD_NULL,
+  FLOOD_XMAS,
+  FLOOD_KINDS,
+};
+
+struct DetectorName {
+  Detector detector;
+  const char *key; // ключ в секции [detectors] конфига
+};
+
+inline constexpr DetectorName detector_names[] = {
+    {DETECT_UDP_FLOOD, "udp_flood"}, {DETECT_ICMP_FLOOD, "icmp_flood"},
+    {DETECT_SYN_FLOOD, "syn_flood"}, {DETECT_FIN_FLOOD, "fin_flood"},
+    {DETECT_NULL_SCAN, "null_scan"}, {DETECT_XMAS_SCAN, "xmas_scan"},
+    {DETECT_PORT_SCAN, "port_scan"}, {DETECT_SSH, "ssh"},
+    {DETECT_TARGET, "target"},       {DETECT_HALF_OPEN, "half_open"},
+};
+
+// Детектор каждого типа флуда, в порядке FloodKind
+inline constexpr Detector flood_detectors[FLOOD_KINDS] = {
+    DETECT_UDP_FLOOD, DETECT_ICMP_FLOOD, DETECT_SYN_FLOOD,
+    DETECT_FIN_FLOOD, DETECT_NULL_SCAN,  DETECT_XMAS_SCAN,
+};
+
+inline const char *detectorKey(uint32_t detector) {
+  for (const auto &entry : detector_names) {
+    if (entry.detector == detector) {
+      return entry.key;
+    }
+  }
+  return "unknown";
+}
+
+#endif // DETECTORSET_H
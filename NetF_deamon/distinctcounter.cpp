@@ -0,0 +1,57 @@
+#include "distinctcounter.h"
+#include "sourcetable.h"
+#include <cmath>
+#include <cstring>
+
+void distinctcounter::setBit(uint32_t value) {
+  uint32_t bit = mix32(value) & (bitmap_bits - 1);
+  uint64_t mask = uint64_t(1) << (bit & 63);
+  if (!(bits[bit >> 6] & mask)) {
+    bits[bit >> 6] |= mask;
+    ++size;
+  }
+}
+
+void distinctcounter::add(uint32_t value) {
+  if (!sketch) {
+    for (uint32_t i = 0; i < size; ++i) {
+      if (values[i] == value) {
+        return;
+      }
+    }
+    if (size < exact_capacity) {
+      values[size++] = value;
+      return;
+    }
+
+    // Точное множество заполнено - переносим его в битовую карту
+    uint32_t exact[exact_capacity];
+    memcpy(exact, values, sizeof(exact));
+    memset(bits, 0, sizeof(bits));
+    size = 0;
+    sketch = true;
+    for (uint32_t old : exact) {
+      setBit(old);
+    }
+  }
+  setBit(value);
+}
+
+uint32_t distinctcounter::estimate(uint32_t ones) {
+  // Оценка зависит только от числа единиц - считаем таблицу один раз
+  static const auto table = [] {
+    struct {
+      uint32_t values[bitmap_bits + 1];
+    } result;
+    for (uint32_t i = 0; i < bitmap_bits; ++i) {
+      double zeros = bitmap_bits - i;
+      result.values[i] =
+          std::lround(-double(bitmap_bits) * std::log(zeros / bitmap_bits));
+    }
+    // Все биты заняты: оценка не определена, берём предел карты
+    result.values[bitmap_bits] =
+        std::lround(bitmap_bits * std::log(double(bitmap_bits)));
+    return result;
+  }();
+  return table.values[ones];
+}
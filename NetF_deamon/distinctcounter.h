@@ -0,0 +1,39 @@
+#ifndef DISTINCTCOUNTER_H
+#define DISTINCTCOUNTER_H
+
+#include <cstdint>
+
+// Число различных значений за окно в фиксированных 72 байтах: 64 байта
+// данных и счётчик с режимом, выровненные до 8. Пока значений мало, они
+// хранятся точно; после 16-го множество заменяется битовой картой на
+// 512 бит с линейным подсчётом (оценка n = -m ln(Z/m) по числу нулевых
+// бит Z). Добавление и count() - O(1). Все 16 точных значений занимают
+// данные целиком, поэтому счётчик лежит отдельно: правило "> 15 портов"
+// проверяется без оценки.
+class distinctcounter {
+public:
+  static constexpr uint32_t exact_capacity = 16;
+  static constexpr uint32_t bitmap_bits = 512;
+
+  void clear() {
+    size = 0;
+    sketch = false;
+  }
+
+  void add(uint32_t value);
+  uint32_t count() const { return sketch ? estimate(size) : size; }
+
+private:
+  void setBit(uint32_t value);
+  static uint32_t estimate(uint32_t ones);
+
+  union {
+    uint32_t values[exact_capacity];
+    uint64_t bits[bitmap_bits / 64];
+  };
+  uint16_t size = 0; // значений в values или единичных бит в bits
+  bool sketch = false;
+};
+static_assert(sizeof(distinctcounter) == 72, "distinctcounter size changed");
+
+#endif // DISTINCTCOUNTER_H
@@ -0,0 +1,179 @@
+#include "ebpf.h"
+#include <cstring>
+#include <fstream>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static int sys_bpf(int command, union bpf_attr &attr) {
+  return syscall(__NR_bpf, command, &attr, sizeof(attr));
+}
+
+static void setName(char (&target)[BPF_OBJ_NAME_LEN], const char *name) {
+  strncpy(target, name, BPF_OBJ_NAME_LEN - 1);
+}
+
+int ebpf::createMap(bpf_map_type type, uint32_t key_size, uint32_t value_size,
+                    uint32_t max_entries, uint32_t flags, const char *name) {
+  union bpf_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.map_type = type;
+  attr.key_size = key_size;
+  attr.value_size = value_size;
+  attr.max_entries = max_entries;
+  attr.map_flags = flags;
+  setName(attr.map_name, name);
+  return sys_bpf(BPF_MAP_CREATE, attr);
+}
+
+int ebpf::loadProgram(bpf_prog_type type, bpf_attach_type attach,
+                      const std::vector<bpf_insn> &code, const char *name,
+                      std::string &log) {
+  static const char license[] = "GPL";
+  std::vector<char> buffer(64 * 1024);
+  union bpf_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.prog_type = type;
+  attr.expected_attach_type = attach;
+  attr.insns = reinterpret_cast<uint64_t>(code.data());
+  attr.insn_cnt = code.size();
+  attr.license = reinterpret_cast<uint64_t>(license);
+  attr.log_buf = reinterpret_cast<uint64_t>(buffer.data());
+  attr.log_size = buffer.size();
+  attr.log_level = 1;
+  setName(attr.prog_name, name);
+  int fd = sys_bpf(BPF_PROG_LOAD, attr);
+  if (fd < 0) {
+    log = buffer.data();
+  }
+  return fd;
+}
+
+int ebpf::attachXdp(int program, int ifindex, uint32_t flags) {
+  union bpf_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.link_create.prog_fd = program;
+  attr.link_create.target_ifindex = ifindex;
+  attr.link_create.attach_type = BPF_XDP;
+  attr.link_create.flags = flags;
+  return sys_bpf(BPF_LINK_CREATE, attr);
+}
+
+bool ebpf::lookup(int map, const void *key, void *value) {
+  union bpf_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.map_fd = map;
+  attr.key = reinterpret_cast<uint64_t>(key);
+  attr.value = reinterpret_cast<uint64_t>(value);
+  return sys_bpf(BPF_MAP_LOOKUP_ELEM, attr) == 0;
+}
+
+bool ebpf::update(int map, const void *key, const void *value,
+                  uint64_t flags) {
+  union bpf_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.map_fd = map;
+  attr.key = reinterpret_cast<uint64_t>(key);
+  attr.value = reinterpret_cast<uint64_t>(value);
+  attr.flags = flags;
+  return sys_bpf(BPF_MAP_UPDATE_ELEM, attr) == 0;
+}
+
+bool ebpf::erase(int map, const void *key) {
+  union bpf_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.map_fd = map;
+  attr.key = reinterpret_cast<uint64_t>(key);
+  return sys_bpf(BPF_MAP_DELETE_ELEM, attr) == 0;
+}
+
+bool ebpf::nextKey(int map, const void *key, void *next) {
+  union bpf_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.map_fd = map;
+  attr.key = reinterpret_cast<uint64_t>(key);
+  attr.next_key = reinterpret_cast<uint64_t>(next);
+  return sys_bpf(BPF_MAP_GET_NEXT_KEY, attr) == 0;
+}
+
+// "0-7" или "0,2-5": ядро раскладывает per-CPU значения по возможным
+// CPU, а не по онлайновым
+uint32_t ebpf::possibleCpus() {
+  static const uint32_t count = [] {
+    std::ifstream file("/sys/devices/system/cpu/possible");
+    std::string ranges;
+    uint32_t total = 0;
+    if (!std::getline(file, ranges)) {
+      return uint32_t(sysconf(_SC_NPROCESSORS_CONF));
+    }
+    size_t pos = 0;
+    while (pos < ranges.size()) {
+      size_t end = ranges.find(',', pos);
+      if (end == std::string::npos) {
+        end = ranges.size();
+      }
+      std::string range = ranges.substr(pos, end - pos);
+      size_t dash = range.find('-');
+      uint32_t first = std::stoul(range.substr(0, dash));
+      uint32_t last = dash == std::string::npos
+                          ? first
+                          : std::stoul(range.substr(dash + 1));
+      total += last - first + 1;
+      pos = end + 1;
+    }
+    return total;
+  }();
+  return count;
+}
+
+bpf_insn ebpf::mov(uint8_t dst, uint8_t src) {
+  return {BPF_ALU64 | BPF_MOV | BPF_X, dst, src, 0, 0};
+}
+
+bpf_insn ebpf::movImm(uint8_t dst, int32_t imm) {
+  return {BPF_ALU64 | BPF_MOV | BPF_K, dst, 0, 0, imm};
+}
+
+bpf_insn ebpf::aluImm(uint8_t op, uint8_t dst, int32_t imm) {
+  return {uint8_t(BPF_ALU64 | op | BPF_K), dst, 0, 0, imm};
+}
+
+bpf_insn ebpf::alu(uint8_t op, uint8_t dst, uint8_t src) {
+  return {uint8_t(BPF_ALU64 | op | BPF_X), dst, src, 0, 0};
+}
+
+bpf_insn ebpf::load(uint8_t size, uint8_t dst, uint8_t src, int16_t off) {
+  return {uint8_t(BPF_LDX | size | BPF_MEM), dst, src, off, 0};
+}
+
+bpf_insn ebpf::store(uint8_t size, uint8_t dst, uint8_t src, int16_t off) {
+  return {uint8_t(BPF_STX | size | BPF_MEM), dst, src, off, 0};
+}
+
+bpf_insn ebpf::storeImm(uint8_t size, uint8_t dst, int16_t off,
+                        int32_t imm) {
+  return {uint8_t(BPF_ST | size | BPF_MEM), dst, 0, off, imm};
+}
+
+bpf_insn ebpf::atomicAdd(uint8_t size, uint8_t dst, uint8_t src,
+                         int16_t off) {
+  return {uint8_t(BPF_STX | size | BPF_ATOMIC), dst, src, off, BPF_ADD};
+}
+
+bpf_insn ebpf::jumpImm(uint8_t op, uint8_t dst, int32_t imm, int16_t off) {
+  return {uint8_t(BPF_JMP | op | BPF_K), dst, 0, off, imm};
+}
+
+bpf_insn ebpf::jumpReg(uint8_t op, uint8_t dst, uint8_t src, int16_t off) {
+  return {uint8_t(BPF_JMP | op | BPF_X), dst, src, off, 0};
+}
+
+bpf_insn ebpf::call(int32_t helper) {
+  return {BPF_JMP | BPF_CALL, 0, 0, 0, helper};
+}
+
+bpf_insn ebpf::exit() { return {BPF_JMP | BPF_EXIT, 0, 0, 0, 0}; }
+
+void ebpf::loadMap(std::vector<bpf_insn> &code, uint8_t dst, int map) {
+  code.push_back({BPF_LD | BPF_DW | BPF_IMM, dst, BPF_PSEUDO_MAP_FD, 0, map});
+  code.push_back({0, 0, 0, 0, 0});
+}
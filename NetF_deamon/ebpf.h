@@ -0,0 +1,54 @@
+#ifndef EBPF_H
+#define EBPF_H
+
+#include <cstdint>
+#include <linux/bpf.h>
+#include <string>
+#include <vector>
+
+// Тонкая обёртка над bpf(2) без libbpf: как и классический префильтр
+// (bpfprefilter), программы eBPF собираются из инструкций прямо в
+// демоне, поэтому сборка не требует clang и BPF-тулчейна. Дескрипторы
+// возвращаются как есть, -1 - ошибка (errno сохраняется).
+class ebpf {
+public:
+  static int createMap(bpf_map_type type, uint32_t key_size,
+                       uint32_t value_size, uint32_t max_entries,
+                       uint32_t flags, const char *name);
+  // log - вывод верификатора при отказе
+  static int loadProgram(bpf_prog_type type, bpf_attach_type attach,
+                         const std::vector<bpf_insn> &code,
+                         const char *name, std::string &log);
+  // Привязка XDP через bpf_link: программа снимается с интерфейса сама,
+  // когда закрывается дескриптор ссылки, в том числе при падении демона
+  static int attachXdp(int program, int ifindex, uint32_t flags);
+
+  static bool lookup(int map, const void *key, void *value);
+  static bool update(int map, const void *key, const void *value,
+                     uint64_t flags = BPF_ANY);
+  static bool erase(int map, const void *key);
+  // key == nullptr - первый ключ
+  static bool nextKey(int map, const void *key, void *next);
+  // Значение per-CPU карты - массив по числу возможных CPU
+  static uint32_t possibleCpus();
+
+  // Инструкции. Регистры - BPF_REG_0..BPF_REG_10.
+  static bpf_insn mov(uint8_t dst, uint8_t src);
+  static bpf_insn movImm(uint8_t dst, int32_t imm);
+  static bpf_insn aluImm(uint8_t op, uint8_t dst, int32_t imm);
+  static bpf_insn alu(uint8_t op, uint8_t dst, uint8_t src);
+  static bpf_insn load(uint8_t size, uint8_t dst, uint8_t src, int16_t off);
+  static bpf_insn store(uint8_t size, uint8_t dst, uint8_t src, int16_t off);
+  static bpf_insn storeImm(uint8_t size, uint8_t dst, int16_t off,
+                           int32_t imm);
+  static bpf_insn atomicAdd(uint8_t size, uint8_t dst, uint8_t src,
+                            int16_t off);
+  static bpf_insn jumpImm(uint8_t op, uint8_t dst, int32_t imm, int16_t off);
+  static bpf_insn jumpReg(uint8_t op, uint8_t dst, uint8_t src, int16_t off);
+  static bpf_insn call(int32_t helper);
+  static bpf_insn exit();
+  // Загрузка дескриптора карты в регистр - две инструкции
+  static void loadMap(std::vector<bpf_insn> &code, uint8_t dst, int map);
+};
+
+#endif // EBPF_H
@@ -1,232 +1,779 @@
-
 #include "firewall.h"
+#include "detectors.h"
+#include "logger.h"
 #include "vector"
+#include <algorithm>
+#include <arpa/inet.h>
 #include <cstdint>
 #include <ctime>
 #include <iomanip>
 #include <iostream>
-#include <map>
 #include <mutex>
 #include <net/ethernet.h>
 #include <netinet/in.h>
 #include <netinet/ip.h>
 #include <netinet/tcp.h>
+#include <netinet/udp.h>
 #include <pcap.h>
 #include <set>
 #include <sys/types.h>
 
-std::vector<firewall::AttackInfo> firewall::detected_attacks;
-std::mutex firewall::attacks_mutex;
-time_t firewall::last_reset_time;
-std::set<uint32_t> firewall::SYNatack_ip_pool;
+firewall::firewall(const DetectorConfig &config)
+    : sources(config.max_sources), source_frequency(config.max_sources),
+      max_scans(config.max_scans), block_ttl(config.block_ttl),
+      targets(config.max_targets), target_frequency(config.max_targets),
+      flows(config.max_flows, config.handshake_timeout, config.flow_timeout),
+      flood_volume(config.flood_volume),
+      kernel_flood(config.flood_mode == "kernel"),
+      rules(std::make_shared<const ruletable>()),
+      alert_queue(std::make_shared<alertqueue>(config.alert_queue)),
+      clock(std::make_unique<coarseclock>()), block_pool(config.max_blocked),
+      max_blocked(config.max_blocked) {
+  source_idle = rules->longestWindow();
+  scans.reserve(max_scans);
+  if (config.flood_mode == "sketch") {
+    for (int kind = 0; kind < FLOOD_KINDS; ++kind) {
+      sketches.push_back(std::make_unique<floodsketch>(
+          config.sketch_width, config.sketch_depth, config.top_k));
+    }
+  }
+}
 
-firewall::firewall() { last_reset_time = time(nullptr); }
+// Наибольшая степень двойки записей, которая помещается в bytes
+static uint32_t tableSlots(uint64_t bytes, size_t record) {
+  uint64_t slots = 16;
+  while (slots * 2 * record <= bytes && slots < (1u << 31)) {
+    slots <<= 1;
+  }
+  return slots;
+}
 
-std::vector<firewall::AttackInfo> firewall::getDetectedAttacks() {
-  std::lock_guard<std::mutex> lock(attacks_mutex);
-  return detected_attacks;
+// Доли бюджета подобраны под обычный трафик: источники - основная
+// часть, потоки TCP следом. Таблицы - степени двойки не больше своей
+// доли. Пул блокировки считается вместе с очередью новых блокировок к
+// главному циклу, остаток покрывает таймеры и скетчи допуска.
+DetectorConfig firewall::fitBudget(DetectorConfig config, uint64_t bytes) {
+  if (config.flood_mode == "sketch") {
+    uint64_t sketch = uint64_t(FLOOD_KINDS) * config.sketch_width *
+                      config.sketch_depth * sizeof(uint32_t);
+    bytes -= std::min(bytes, sketch);
+  }
+  config.max_sources = tableSlots(bytes * 40 / 100, sizeof(SourceState));
+  config.max_flows = tableSlots(bytes * 25 / 100, sizeof(flowtable::Flow));
+  config.max_targets = tableSlots(bytes * 10 / 100, sizeof(TargetState));
+  config.max_scans = std::max<uint64_t>(bytes * 15 / 100 / sizeof(ScanState),
+                                        1);
+  config.max_blocked = tableSlots(bytes * 5 / 100,
+                                  sizeof(BlockState) + sizeof(BlockInfo));
+  return config;
+}
+
+void firewall::setClock(std::unique_ptr<detectorclock> clock) {
+  this->clock = std::move(clock);
+}
+
+void firewall::setFanout(uint32_t workers) { fanout = std::max(workers, 1u); }
+
+void firewall::setKernelCounters(std::unique_ptr<kernelflood> counters) {
+  kernel = std::move(counters);
 }
 
-void firewall::clearDetectedAttacks() {
+void firewall::setAlertQueue(std::shared_ptr<alertqueue> queue) {
+  alert_queue = std::move(queue);
+}
+
+std::vector<firewall::BlockInfo> firewall::takeBlockedSources() {
+  std::vector<BlockInfo> blocked;
   std::lock_guard<std::mutex> lock(attacks_mutex);
-  detected_attacks.clear();
+  blocked.swap(blocked_sources);
+  return blocked;
 }
 
-void firewall::cleanupOldEntries(std::map<uint32_t, int> &attempts,
-                                 std::map<uint32_t, time_t> &timestamps,
-                                 time_t timeout) {
-  time_t now = time(nullptr);
-  for (auto it = timestamps.begin(); it != timestamps.end();) {
-    if (now - it->second > timeout) {
-      attempts.erase(it->first);
-      it = timestamps.erase(it);
-    } else {
-      ++it;
+// Переполненная очередь теряет алерт сама и учитывает это; блокировка
+// источника от этого не зависит
+void firewall::reportAttack(AttackType type, uint32_t ip, uint32_t count,
+                            EventTime now, bool target) {
+  Counters::bump(stats.alerts);
+  alert_queue->push(
+      {ip, count, uint32_t(toUnixTime(now)), type, 32, target, 0});
+}
+
+void firewall::setRules(std::shared_ptr<const ruletable> rules) {
+  pending_rules.store(std::move(rules));
+  rules_version.fetch_add(1, std::memory_order_release);
+}
+
+// Проверка версии - одно атомарное чтение на пачку; сам указатель
+// забирается только после setRules
+void firewall::refreshRules() {
+  uint64_t version = rules_version.load(std::memory_order_acquire);
+  if (version == applied_version) {
+    return;
+  }
+  applied_version = version;
+  rules = pending_rules.load();
+  // Записи, заведённые при старых правилах, доживут по новому сроку:
+  // таймер пересчитывает его при срабатывании
+  source_idle = rules->longestWindow();
+}
+
+void firewall::rollWindow(SourceState &source, EventTime window,
+                          EventTime now) {
+  uint32_t epoch = now / window;
+  if (source.epoch == epoch) {
+    return;
+  }
+  const bool adjacent = epoch == source.epoch + 1;
+  for (int kind = 0; kind < FLOOD_KINDS; ++kind) {
+    source.flood_prev[kind] = adjacent ? source.flood[kind] : 0;
+    source.flood[kind] = 0;
+  }
+  source.epoch = epoch;
+  source.alerted = 0;
+}
+
+// Скорость оценивается скользящим окном: пакеты текущего окна плюс доля
+// предыдущего, пропорциональная ещё не прошедшей части текущего. Каждый
+// детектор каждого источника считается независимо и сразу на пакете,
+// без общего сброса по таймеру.
+void firewall::checkFloodAttack(SourceState &source, FloodKind kind,
+                                const Thresholds &limits, EventTime now) {
+  const EventTime window = EventTime(limits.flood_window_ms) * 1000;
+  rollWindow(source, window, now);
+  if (source.flood[kind] < UINT16_MAX) {
+    source.flood[kind]++;
+  }
+  if (source.alerted & (1u << kind)) {
+    return;
+  }
+
+  EventTime remaining = window - now % window;
+  uint32_t rate =
+      source.flood[kind] + source.flood_prev[kind] * remaining / window;
+  if (rate > limits.flood[kind]) {
+    reportAttack(AttackType(kind), source.key, rate, now);
+    blockSource(source.key, now);
+    source.alerted |= 1u << kind;
+  }
+}
+
+// Источники в скетч не записываются, поэтому подменённые адреса не
+// занимают таблицу; по окну отчитываются тяжёлые источники из top-K и
+// суммарный объём флуда. Окно скетча общее - из правил по умолчанию,
+// порог каждого тяжёлого адреса - из его правила.
+void firewall::checkFloodSketch(FloodKind kind, uint32_t src_ip) {
+  floodsketch &sketch = *sketches[kind];
+  sketch.add(src_ip);
+  EventTime now = clock->now();
+  EventTime &started = sketch_window[kind];
+  if (started == 0) {
+    started = now;
+  }
+
+  const EventTime window =
+      EventTime(rules->fallback().thresholds.flood_window_ms) * 1000;
+  if (now - started >= window) {
+    uint64_t heavy = 0;
+    const uint64_t error = sketch.errorBound();
+    sketch.forEachHeavy(
+        rules->lowestFlood(kind), [&](uint32_t ip, uint32_t count) {
+          if (count <= rules->match(ip).thresholds.flood[kind] + error) {
+            return;
+          }
+          reportAttack(AttackType(kind), ip, count, now);
+          blockSource(ip, now);
+          ++heavy;
+        });
+    if (sketch.total() > flood_volume) {
+      logger::log(LogLevel::WARN, LogEvent::FLOOD_VOLUME,
+                  flood_detectors[kind], sketch.total(),
+                  (now - started) / 1000, heavy);
     }
+    sketch.reset();
+    started = now;
   }
 }
 
-void firewall::checkFloodAttack(uint32_t src_ip,
-                                std::map<uint32_t, int> &count_map,
-                                int threshold, const std::string &attack_name) {
-  count_map[src_ip]++;
-  time_t now = time(nullptr);
+// Суммы ядра за окно сверяются с порогами правил источников; списки
+// действуют, как и на пакетах. Окно - из правил по умолчанию, как у
+// скетча.
+void firewall::checkKernelFlood() {
+  const EventTime now = clock->now();
+  if (kernel_window == 0) {
+    kernel_window = now;
+  }
+  const EventTime window =
+      EventTime(rules->fallback().thresholds.flood_window_ms) * 1000;
+  if (now - kernel_window < window || !kernel->rotate(kernel_totals)) {
+    return;
+  }
 
-  if (now - last_reset_time >= 1) {
-    for (auto &[ip, count] : count_map) {
-      if (count > threshold) {
-        char ip_str[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &ip, ip_str, INET_ADDRSTRLEN);
+  uint64_t total[FLOOD_KINDS] = {};
+  uint64_t heavy[FLOOD_KINDS] = {};
+  for (const kernelflood::Totals &source : kernel_totals) {
+    if (rules->verdict(source.ip) != Verdict::NONE) {
+      continue;
+    }
+    const Rule &rule = rules->match(source.ip);
+    for (int kind = 0; kind < FLOOD_KINDS; ++kind) {
+      const uint32_t count = source.packets[kind];
+      total[kind] += count;
+      if (!(rule.detectors & DetectorPipeline::mask &
+            flood_detectors[kind]) ||
+          count <= rule.thresholds.flood[kind]) {
+        continue;
+      }
+      reportAttack(AttackType(kind), source.ip, count, now);
+      blockSource(source.ip, now);
+      ++heavy[kind];
+    }
+  }
+  for (int kind = 0; kind < FLOOD_KINDS; ++kind) {
+    if (total[kind] > flood_volume) {
+      logger::log(LogLevel::WARN, LogEvent::FLOOD_VOLUME,
+                  flood_detectors[kind], total[kind],
+                  (now - kernel_window) / 1000, heavy[kind]);
+    }
+  }
+  kernel_window = now;
+}
 
-        std::lock_guard<std::mutex> lock(attacks_mutex);
-        detected_attacks.push_back({attack_name, ip_str, count, now});
+void firewall::releaseScan(SourceState &source) {
+  if (source.scan) {
+    free_scans.push_back(source.scan - 1);
+    source.scan = 0;
+  }
+}
 
-        SYNatack_ip_pool.insert(ip);
+// Пробы без ACK за окно scan_window: больше scan_ports различных портов -
+// вертикальный скан, больше scan_hosts адресов на одном порту -
+// горизонтальный
+void firewall::checkPortScan(SourceState &source, uint32_t dst_ip,
+                             uint16_t port, const Thresholds &limits,
+                             EventTime now) {
+  const uint32_t seconds = toUnixTime(now);
+  if (source.scan &&
+      seconds - scans[source.scan - 1].start > limits.scan_window) {
+    releaseScan(source);
+  }
+  if (!source.scan) {
+    if (free_scans.empty()) {
+      if (scans.size() >= max_scans) {
+        Counters::bump(stats.scans_full);
+        return;
       }
+      scans.emplace_back();
+      source.scan = scans.size();
+    } else {
+      source.scan = free_scans.back() + 1;
+      free_scans.pop_back();
+    }
+    ScanState &fresh = scans[source.scan - 1];
+    fresh.ports.clear();
+    fresh.hosts.clear();
+    fresh.start = seconds;
+    fresh.host_port = port;
+  }
+
+  ScanState &scan = scans[source.scan - 1];
+  scan.ports.add(port);
+  if (port == scan.host_port) {
+    scan.hosts.add(dst_ip);
+  }
+
+  if (scan.ports.count() > limits.scan_ports) {
+    logger::log(LogLevel::WARN, LogEvent::PORT_SCAN, source.key,
+                scan.ports.count(), seconds - scan.start);
+    reportAttack(ATTACK_PORT_SCAN, source.key, scan.ports.count(), now);
+    blockSource(source.key, now);
+    releaseScan(source);
+  } else if (scan.hosts.count() > limits.scan_hosts) {
+    logger::log(LogLevel::WARN, LogEvent::HOST_SCAN, source.key,
+                scan.host_port, scan.hosts.count(), seconds - scan.start);
+    reportAttack(ATTACK_HOST_SCAN, source.key, scan.hosts.count(), now);
+    blockSource(source.key, now);
+    releaseScan(source);
+  }
+}
+
+// Попытка сверх лимита - на пересечении порога и дальше каждые limit + 1
+// попыток, а не на каждом пакете; пул продлевается тем же шагом
+static bool sshReport(uint32_t attempts, uint32_t limit) {
+  return attempts > limit && attempts % (uint64_t(limit) + 1) == 0;
+}
+
+void firewall::checkSsh(SourceState &source, uint8_t flags,
+                        const Thresholds &limits, EventTime now) {
+  const uint32_t seconds = toUnixTime(now);
+  if (flags == TH_SYN) {
+    if (seconds - source.ssh_connect_time > limits.ssh_window) {
+      source.ssh_connect = 0;
+    }
+    if (source.ssh_connect < UINT16_MAX) {
+      source.ssh_connect++;
+    }
+    source.ssh_connect_time = seconds;
+
+    if (sshReport(source.ssh_connect, limits.ssh_connect)) {
+      logger::log(LogLevel::WARN, LogEvent::SSH_CONNECT, source.key,
+                  source.ssh_connect, limits.ssh_window);
+      reportAttack(ATTACK_SSH_CONNECT, source.key, source.ssh_connect, now);
+      blockSource(source.key, now);
+    }
+  }
+
+  if ((flags & (TH_SYN | TH_FIN | TH_RST)) == 0) {
+    if (seconds - source.ssh_bruteforce_time > limits.ssh_window) {
+      source.ssh_bruteforce = 0;
+    }
+    if (source.ssh_bruteforce < UINT16_MAX) {
+      source.ssh_bruteforce++;
+    }
+    source.ssh_bruteforce_time = seconds;
+
+    if (sshReport(source.ssh_bruteforce, limits.ssh_bruteforce)) {
+      logger::log(LogLevel::WARN, LogEvent::SSH_BRUTEFORCE, source.key,
+                  source.ssh_bruteforce, limits.ssh_window);
+      reportAttack(ATTACK_SSH_BRUTEFORCE, source.key, source.ssh_bruteforce,
+                   now);
+      blockSource(source.key, now);
+    }
+  }
+}
+
+// Распределённый флуд: каждый источник ниже своих порогов, но вместе
+// они заваливают один адрес. Fanout делит источники между воркерами,
+// поэтому воркер видит долю 1/fanout трафика жертвы, и счёт
+// масштабируется обратно; при тысячах подменённых адресов доли почти
+// равны. Адрес жертвы в пул блокировки, конечно, не попадает.
+void firewall::checkTarget(uint64_t key, uint32_t src_ip,
+                           const Thresholds &limits, EventTime now) {
+  TargetState *target = targetState(key, limits, now);
+  if (!target) {
+    return;
+  }
+  if (target->packets < UINT32_MAX) {
+    target->packets++;
+  }
+  target->sources.add(src_ip);
+  if (target->alerted & TARGET_ALERT) {
+    return;
+  }
+
+  const EventTime window = EventTime(limits.flood_window_ms) * 1000;
+  EventTime remaining = window - now % window;
+  uint64_t rate =
+      (target->packets + target->packets_prev * remaining / window) * fanout;
+  uint64_t sources = uint64_t(target->sources.count()) * fanout;
+  if (rate > limits.target_packets && sources >= limits.target_sources) {
+    const uint32_t ip = key >> 32;
+    logger::log(LogLevel::WARN, LogEvent::TARGET_ATTACK, ip,
+                uint32_t(key), rate, sources, limits.flood_window_ms);
+    reportAttack(ATTACK_TARGET, ip, rate, now, true);
+    target->alerted |= TARGET_ALERT;
+  }
+}
+
+// Запись адреса назначения с окном, сдвинутым к now
+firewall::TargetState *firewall::targetState(uint64_t key,
+                                             const Thresholds &limits,
+                                             EventTime now) {
+  target_frequency.record(key);
+  TargetState *target = targets.findOrReplace(key, [&](TargetState &victim) {
+    if (!target_frequency.admits(key, victim.key)) {
+      return false;
+    }
+    evicted++;
+    return true;
+  });
+  if (!target) {
+    Counters::bump(stats.targets_full);
+    return nullptr;
+  }
+  target->referenced = true;
+  if (target->last_seen == 0) {
+    target->timer = ++timer_generation;
+    timers.schedule(key, TARGET_TIMER,
+                    now + EventTime(source_idle + 1) * USEC_PER_SEC, now,
+                    target->timer);
+  }
+  target->last_seen = toUnixTime(now);
+
+  const EventTime window = EventTime(limits.flood_window_ms) * 1000;
+  uint32_t epoch = now / window;
+  if (target->epoch != epoch) {
+    target->packets_prev = epoch == target->epoch + 1 ? target->packets : 0;
+    target->packets = 0;
+    target->sources.clear();
+    target->handshakes = 0;
+    target->completed = 0;
+    target->epoch = epoch;
+    target->alerted = 0;
+  }
+  return target;
+}
+
+// SYN-флуд с подменой адресов: каждый источник шлёт пару SYN и по
+// порогам источника не виден, зато рукопожатия к серверу не
+// завершаются. Алерт - когда полуоткрытых потоков на порт много и
+// завершилась лишь малая доля начатых за окно рукопожатий; всплеск
+// честных подключений даёт много полуоткрытых, но высокую долю.
+// Потоки делятся между воркерами по клиенту, поэтому счёт
+// полуоткрытых масштабируется на fanout, а доля от него не зависит.
+void firewall::checkHalfOpen(const FlowKey &flow, FlowChange change,
+                             EventTime now) {
+  const Rule &rule = rules->match(flow.server);
+  if (!(rule.detectors & DETECT_HALF_OPEN)) {
+    return;
+  }
+  const Thresholds &limits = rule.thresholds;
+  const uint64_t key = uint64_t(flow.server) << 32 | (flow.server_port + 1u);
+  TargetState *target = targetState(key, limits, now);
+  if (!target) {
+    return;
+  }
+  if (change == FlowChange::ESTABLISHED) {
+    target->completed++;
+  }
+  if (change != FlowChange::OPENED) {
+    target->half_open -= target->half_open > 0;
+    return;
+  }
+
+  target->handshakes++;
+  target->half_open++;
+  if (target->alerted & HALF_OPEN_ALERT) {
+    return;
+  }
+  const uint64_t half_open = uint64_t(target->half_open) * fanout;
+  if (half_open > limits.half_open &&
+      uint64_t(target->completed) * 100 <
+          uint64_t(target->handshakes) * limits.min_completion) {
+    logger::log(LogLevel::WARN, LogEvent::HALF_OPEN, flow.server,
+                flow.server_port, half_open, target->handshakes,
+                target->completed, limits.flood_window_ms);
+    reportAttack(ATTACK_HALF_OPEN, flow.server, half_open, now, true);
+    target->alerted |= HALF_OPEN_ALERT;
+  }
+}
+
+// Рукопожатие истекло в таблице потоков, не завершившись
+void firewall::releaseHalfOpen(const FlowKey &flow) {
+  const uint64_t key = uint64_t(flow.server) << 32 | (flow.server_port + 1u);
+  if (TargetState *target = targets.find(key)) {
+    target->half_open -= target->half_open > 0;
+  }
+}
+
+// Заполненный пул забывает адрес, давно не продлевавшийся: в nftables
+// и XDP он доживает свой срок, а новый алерт вернёт его в пул.
+// Продлённый адрес уходит в ядро повторно, когда его запись там
+// прожила половину срока: атака, идущая дольше block_ttl, не выходит
+// из блокировки, а каждый алерт не превращается в транзакцию nft.
+void firewall::blockSource(uint32_t ip, EventTime now) {
+  const uint32_t seconds = toUnixTime(now);
+  BlockState *block = block_pool.findOrReplace(ip, [&](BlockState &) {
+    evicted++;
+    return true;
+  });
+  block->referenced = true;
+  // Истёкшая запись, которую обход ещё не убрал, - тоже новая
+  const bool fresh = block->until <= seconds;
+  block->until = seconds + block_ttl;
+  if (!fresh && block->mitigated >= seconds + block_ttl / 2) {
+    return;
+  }
+  block->mitigated = block->until;
+  std::lock_guard<std::mutex> lock(attacks_mutex);
+  if (blocked_sources.size() >= max_blocked) {
+    Counters::bump(stats.blocks_dropped);
+    return;
+  }
+  blocked_sources.push_back({ip, seconds});
+}
+
+// Таймеры не снимаются при активности: сработав, таймер проверяет,
+// продлилась ли жизнь объекта, и либо удаляет его, либо встаёт заново
+void firewall::expireTimer(const timerwheel::Timer &timer, EventTime now) {
+  const uint32_t seconds = toUnixTime(now);
+  uint32_t deadline;
+  if (timer.kind == SOURCE_TIMER) {
+    SourceState *state = sources.find(uint32_t(timer.key));
+    if (!state || state->timer != timer.tag) {
+      return; // запись вытеснена, у новой записи свой таймер
     }
-    count_map.clear();
-    last_reset_time = now;
+    // Запись не нужна, когда источник молчит дольше самого длинного
+    // окна детекторов
+    deadline = state->last_seen + source_idle;
+    if (seconds > deadline) {
+      releaseScan(*state);
+      sources.erase(state);
+      return;
+    }
+  } else {
+    TargetState *target = targets.find(timer.key);
+    if (!target || target->timer != timer.tag) {
+      return;
+    }
+    // Пока у адреса есть полуоткрытые потоки, их истечение ещё придёт
+    deadline = target->last_seen + source_idle;
+    if (seconds > deadline && target->half_open == 0) {
+      targets.erase(target);
+      return;
+    }
+  }
+  timers.schedule(timer.key, timer.kind, EventTime(deadline + 1) * USEC_PER_SEC,
+                  now, timer.tag);
+}
+
+uint32_t firewall::supportedDetectors() { return DetectorPipeline::mask; }
+
+// Запись источника ищется один раз на пакет и только если пакет нужен
+// хотя бы одному детектору
+firewall::SourceState *firewall::PacketContext::state() {
+  if (looked_up) {
+    return source;
+  }
+  looked_up = true;
+  owner.source_frequency.record(packet.src_ip);
+  source = owner.sources.findOrReplace(
+      packet.src_ip, [&](SourceState &victim) {
+        if (!owner.source_frequency.admits(packet.src_ip, victim.key)) {
+          return false;
+        }
+        owner.releaseScan(victim);
+        owner.evicted++;
+        return true;
+      });
+  if (!source) {
+    Counters::bump(owner.stats.table_full);
+    return nullptr;
+  }
+  source->referenced = true;
+  if (source->last_seen == 0) {
+    source->timer = ++owner.timer_generation;
+    owner.timers.schedule(
+        packet.src_ip, SOURCE_TIMER,
+        packet.now + EventTime(owner.source_idle + 1) * USEC_PER_SEC,
+        packet.now, source->timer);
+  }
+  source->last_seen = toUnixTime(packet.now);
+  return source;
+}
+
+void firewall::PacketContext::flood(FloodKind kind) {
+  if (owner.kernel_flood) {
+    return;
+  }
+  if (!owner.sketches.empty()) {
+    owner.checkFloodSketch(kind, packet.src_ip);
+  } else if (SourceState *state = this->state()) {
+    owner.checkFloodAttack(*state, kind, rule.thresholds, packet.now);
+  }
+}
+
+void firewall::PacketContext::portScan() {
+  if (SourceState *state = this->state()) {
+    owner.checkPortScan(*state, packet.dst_ip, packet.dport, rule.thresholds,
+                        packet.now);
+  }
+}
+
+void firewall::PacketContext::ssh() {
+  if (SourceState *state = this->state()) {
+    owner.checkSsh(*state, packet.tcp_flags, rule.thresholds, packet.now);
+  }
+}
+
+// Пороги и включение учёта берутся из правила адреса назначения: для
+// своих серверов их задают переопределением подсети. Пакет считается
+// и по адресу целиком, и по его порту.
+void firewall::PacketContext::target() {
+  const Rule &target_rule = owner.rules->match(packet.dst_ip);
+  if (!(target_rule.detectors & DETECT_TARGET)) {
+    return;
+  }
+  const uint64_t host = uint64_t(packet.dst_ip) << 32;
+  owner.checkTarget(host, packet.src_ip, target_rule.thresholds, packet.now);
+  if (packet.dport != 0) {
+    owner.checkTarget(host | (packet.dport + 1u), packet.src_ip,
+                      target_rule.thresholds, packet.now);
+  }
+}
+
+void firewall::PacketContext::flow() {
+  FlowKey key;
+  std::optional<FlowKey> abandoned;
+  const FlowChange change =
+      owner.flows.update(packet, toUnixTime(packet.now), key, abandoned);
+  if (abandoned) {
+    owner.releaseHalfOpen(*abandoned);
+  }
+  if (change == FlowChange::FULL) {
+    Counters::bump(owner.stats.flows_full);
+  } else if (change != FlowChange::NONE) {
+    owner.checkHalfOpen(key, change, packet.now);
+  }
+}
+
+static uint64_t macValue(const uint8_t *mac) {
+  uint64_t value = 0;
+  for (int i = 0; i < ETH_ALEN; ++i) {
+    value = (value << 8) | mac[i];
+  }
+  return value;
+}
+
+void firewall::analyzeBatch(const PacketBatch &batch) {
+  refreshRules();
+  clock->beginBatch(batch);
+  for (size_t i = 0; i < batch.count; ++i) {
+    clock->observe(&batch.headers[i]);
+    expireTimers(16);
+    analyzePacket(batch.data[i], &batch.headers[i]);
+  }
+  // 16 шагов на пакет идут только с трафиком: при редких пакетах
+  // полуоткрытые потоки и блокировки висели бы долго, а poll бэкенда
+  // не доходит до idle. Поэтому полный проход - по часам, как в idle.
+  if (clock->now() >= next_expiry) {
+    expireIdle();
+  }
+  if (kernel) {
+    checkKernelFlood();
+  }
+  publishOccupancy();
+}
+
+void firewall::publishOccupancy() {
+  const auto relaxed = std::memory_order_relaxed;
+  stats.sources_used.store(sources.size(), relaxed);
+  stats.targets_used.store(targets.size(), relaxed);
+  stats.flows_used.store(flows.size(), relaxed);
+  stats.scans_used.store(scans.size() - free_scans.size(), relaxed);
+  stats.evictions.store(evicted + flows.evictions(), relaxed);
+}
+
+void firewall::idle() {
+  static const PacketBatch empty{};
+  refreshRules();
+  clock->beginBatch(empty);
+  expireIdle();
+  if (kernel) {
+    checkKernelFlood();
+  }
+  publishOccupancy();
+}
+
+// Не реже раза в 100 мс по часам детектора, с пакетами или без
+void firewall::expireIdle() {
+  expireTimers(1024);
+  next_expiry = clock->now() + USEC_PER_SEC / 10;
+}
+
+// Истечения размазаны по пакетам: за раз не больше budget таймеров,
+// поэтому волна истёкших источников не даёт пика задержки
+void firewall::expireTimers(size_t budget) {
+  const EventTime now = clock->now();
+  if (now > 0) {
+    timers.advance(now, budget, [&](const timerwheel::Timer &timer) {
+      expireTimer(timer, now);
+    });
+    const uint32_t seconds = toUnixTime(now);
+    flows.expire(seconds, budget,
+                 [&](const FlowKey &flow) { releaseHalfOpen(flow); });
+    block_pool.sweep(block_cursor, budget, [&](const BlockState &block) {
+      return seconds >= block.until;
+    });
   }
 }
 
 void firewall::analyzePacket(const u_char *packet,
                              const struct pcap_pkthdr *header) {
-  static std::map<uint32_t, int> UDP_count_map;
-  static std::map<uint32_t, int> ICMP_count_map;
-  static std::map<uint32_t, int> SYN_count_map;
-  static std::map<uint32_t, int> FIN_count_map;
-  static std::map<uint32_t, int> Null_Scan_count_map;
-  static std::map<uint32_t, int> Xmas_Scan_count_map;
-  static std::map<uint32_t, std::set<uint16_t>> scanned_ports;
-  static std::map<uint32_t, time_t> scaned_ports_timestamps;
-
-  std::cout << "\nPacket size: " << header->len << " bytes"
-            << " | Captured: " << header->caplen << " bytes"
-            << " | Timestamp: " << header->ts.tv_sec << "." << std::setfill('0')
-            << std::setw(6) << header->ts.tv_usec << std::endl;
+  Counters::bump(stats.packets);
+
+  const bool trace = logger::enabled(LogLevel::TRACE);
+  if (trace) {
+    logger::log(LogLevel::TRACE, LogEvent::PACKET, header->len, header->caplen,
+                header->ts.tv_sec, header->ts.tv_usec);
+  }
 
   if (header->caplen < sizeof(struct ether_header)) {
-    std::cout << "Truncated packet (too small for Ethernet header)"
-              << std::endl;
+    logger::log(LogLevel::DEBUG, LogEvent::TRUNCATED_ETHER);
     return;
   }
 
   struct ether_header *eth = (struct ether_header *)packet;
-  std::cout << "Ethernet: "
-            << "Dest: " << std::hex << std::setfill('0') << std::setw(2)
-            << (int)eth->ether_dhost[0] << ":" << std::setw(2)
-            << (int)eth->ether_dhost[1] << ":" << std::setw(2)
-            << (int)eth->ether_dhost[2] << ":" << std::setw(2)
-            << (int)eth->ether_dhost[3] << ":" << std::setw(2)
-            << (int)eth->ether_dhost[4] << ":" << std::setw(2)
-            << (int)eth->ether_dhost[5] << "  "
-            << "Source: " << std::setw(2) << (int)eth->ether_shost[0] << ":"
-            << std::setw(2) << (int)eth->ether_shost[1] << ":" << std::setw(2)
-            << (int)eth->ether_shost[2] << ":" << std::setw(2)
-            << (int)eth->ether_shost[3] << ":" << std::setw(2)
-            << (int)eth->ether_shost[4] << ":" << std::setw(2)
-            << (int)eth->ether_shost[5] << "  "
-            << "Type: 0x" << std::setw(4) << ntohs(eth->ether_type) << std::dec
-            << std::endl;
+  if (trace) {
+    logger::log(LogLevel::TRACE, LogEvent::ETHERNET, macValue(eth->ether_dhost),
+                macValue(eth->ether_shost), ntohs(eth->ether_type));
+  }
 
   if (ntohs(eth->ether_type) == ETHERTYPE_IP) {
     if (header->caplen < sizeof(struct ether_header) + sizeof(struct ip)) {
-      std::cout << "Truncated IP packet" << std::endl;
+      logger::log(LogLevel::DEBUG, LogEvent::TRUNCATED_IP);
       return;
     }
 
     struct ip *iph = (struct ip *)(packet + sizeof(struct ether_header));
     uint32_t src_ip = iph->ip_src.s_addr;
+    Counters::bump(stats.ipv4);
 
-    std::cout << "IP: "
-              << "Version: " << iph->ip_v << " Header len: " << (iph->ip_hl * 4)
-              << " bytes"
-              << " TTL: " << (int)iph->ip_ttl << " Protocol: " << (int)iph->ip_p
-              << " Source: " << inet_ntoa(iph->ip_src)
-              << " Dest: " << inet_ntoa(iph->ip_dst) << std::endl;
+    // Списки проверяются раньше всех детекторов: разрешённые источники
+    // не анализируются вовсе, запрещённые только считаются
+    switch (rules->verdict(src_ip)) {
+    case Verdict::ALLOW:
+      Counters::bump(stats.allowed);
+      return;
+    case Verdict::DENY:
+      Counters::bump(stats.denied);
+      return;
+    case Verdict::NONE:
+      break;
+    }
 
-    if (iph->ip_p == IPPROTO_UDP) {
-      checkFloodAttack(src_ip, UDP_count_map, 1, "UDP flood");
+    if (trace) {
+      logger::log(LogLevel::TRACE, LogEvent::IPV4, iph->ip_v, iph->ip_hl * 4,
+                  iph->ip_ttl, iph->ip_p, iph->ip_src.s_addr,
+                  iph->ip_dst.s_addr);
     }
-    if (iph->ip_p == IPPROTO_ICMP) {
-      checkFloodAttack(src_ip, ICMP_count_map, 1, "ICMP flood");
+
+    if (iph->ip_p != IPPROTO_UDP && iph->ip_p != IPPROTO_ICMP &&
+        iph->ip_p != IPPROTO_TCP) {
+      return;
     }
-    if (iph->ip_p == 6) {
+
+    PacketView view = {};
+    view.src_ip = src_ip;
+    view.dst_ip = iph->ip_dst.s_addr;
+    view.protocol = iph->ip_p;
+    view.now = clock->now();
+
+    if (iph->ip_p == IPPROTO_TCP) {
       int ip_header_len = iph->ip_hl * 4;
       if (header->caplen <
           sizeof(struct ether_header) + ip_header_len + sizeof(struct tcphdr)) {
-        std::cout << "Truncated TCP packet" << std::endl;
+        logger::log(LogLevel::DEBUG, LogEvent::TRUNCATED_TCP);
         return;
       }
 
       struct tcphdr *tcph =
           (struct tcphdr *)(packet + sizeof(struct ether_header) +
                             ip_header_len);
-      uint8_t flags = tcph->th_flags;
-
-      scanned_ports[src_ip].insert(ntohs(tcph->th_dport));
-      scaned_ports_timestamps[src_ip] = time(nullptr);
-
-      if (scanned_ports[src_ip].size() > 15) {
-        time_t now = time(nullptr);
-        if (now - scaned_ports_timestamps[src_ip] < 60) {
-          std::cout << "[ALERT] Port Scan detected from: "
-                    << inet_ntoa(iph->ip_src) << " ("
-                    << scanned_ports[src_ip].size() << " ports in "
-                    << (now - scaned_ports_timestamps[src_ip]) << " seconds)"
-                    << std::endl;
-          SYNatack_ip_pool.insert(src_ip);
-          scanned_ports.erase(src_ip);
-          scaned_ports_timestamps.erase(src_ip);
-        }
-      }
-
-      if (ntohs(tcph->th_dport) == 22) {
-        static std::map<uint32_t, int> ssh_connect_attempts;
-        static std::map<uint32_t, int> ssh_bruteforce_attempts;
-        static std::map<uint32_t, time_t> last_ssh_connect;
-        static std::map<uint32_t, time_t> last_ssh_bruteforce;
-        time_t now = time(nullptr);
-        last_ssh_connect[src_ip] = now;
-
-        if (tcph->th_flags == TH_SYN) {
-          if (now - last_ssh_connect[src_ip] > 60) {
-            ssh_connect_attempts[src_ip] = 0;
-          }
-
-          ssh_connect_attempts[src_ip]++;
-          last_ssh_connect[src_ip] = now;
-
-          if (ssh_connect_attempts[src_ip] > 5) {
-            std::cout << "[ALERT] Possible SSH connection flood from: "
-                      << inet_ntoa(iph->ip_src) << " ("
-                      << ssh_connect_attempts[src_ip] << " SYNs in 60s)"
-                      << std::endl;
-            SYNatack_ip_pool.insert(src_ip);
-          }
-        }
-
-        if ((tcph->th_flags & (TH_SYN | TH_FIN | TH_RST)) == 0) {
-          if (now - last_ssh_connect[src_ip] > 60) {
-            ssh_bruteforce_attempts[src_ip] = 0;
-          }
-
-          ssh_bruteforce_attempts[src_ip]++;
-          last_ssh_bruteforce[src_ip] = now;
-
-          if (ssh_bruteforce_attempts[src_ip] > 10) {
-            std::cout << "[ALERT] Possible SSH bruteforce from: "
-                      << inet_ntoa(iph->ip_src) << " ("
-                      << ssh_bruteforce_attempts[src_ip]
-                      << " auth attempts in 60s)" << std::endl;
-            SYNatack_ip_pool.insert(src_ip);
-          }
-        }
-
-        static time_t last_cleanup = 0;
-        if (now - last_cleanup > 300) {
-          cleanupOldEntries(ssh_connect_attempts, last_ssh_connect, 300);
-          cleanupOldEntries(ssh_bruteforce_attempts, last_ssh_bruteforce, 300);
-          last_cleanup = now;
-        }
-      }
-
-      if ((flags & TH_SYN) && !(flags & TH_ACK)) {
-        checkFloodAttack(src_ip, SYN_count_map, 20, "SYN flood");
-      }
-
-      if ((flags & TH_FIN) && (flags & TH_URG) && (flags & TH_PUSH) &&
-          !(flags & TH_SYN) && !(flags & TH_ACK)) {
-        checkFloodAttack(src_ip, Xmas_Scan_count_map, 10, "Xmas Scan");
-      }
-
-      if ((flags & TH_FIN) && !(flags & TH_SYN)) {
-        checkFloodAttack(src_ip, FIN_count_map, 20, "FIN flood");
-      }
-
-      if ((flags & (TH_SYN | TH_ACK | TH_FIN | TH_RST)) == 0) {
-        checkFloodAttack(src_ip, Null_Scan_count_map, 20, "Null Scan");
-      }
+      view.tcp_flags = tcph->th_flags;
+      view.sport = ntohs(tcph->th_sport);
+      view.dport = ntohs(tcph->th_dport);
+    } else if (iph->ip_p == IPPROTO_UDP &&
+               header->caplen >= sizeof(struct ether_header) +
+                                     iph->ip_hl * 4 + sizeof(struct udphdr)) {
+      struct udphdr *udph = (struct udphdr *)(packet +
+                                              sizeof(struct ether_header) +
+                                              iph->ip_hl * 4);
+      view.sport = ntohs(udph->uh_sport);
+      view.dport = ntohs(udph->uh_dport);
     }
+
+    const Rule &rule = rules->match(src_ip);
+    PacketContext context(*this, view, rule);
+    DetectorPipeline::run(rule.detectors, context, view);
   }
-}
\ No newline at end of file
+}
@@ -1,49 +1,303 @@
 #ifndef FIREWALL_H
 #define FIREWALL_H
 
+#include "alertqueue.h"
+#include "detectorclock.h"
+#include "detectorpipeline.h"
+#include "detectorset.h"
+#include "distinctcounter.h"
+#include "floodsketch.h"
+#include "flowtable.h"
+#include "frequencysketch.h"
+#include "kernelflood.h"
+#include "packetbatch.h"
+#include "ruletable.h"
+#include "sourcetable.h"
+#include "timerwheel.h"
+#include <atomic>
 #include <cstdint>
 #include <ctime>
 #include <iomanip>
 #include <iostream>
-#include <map>
+#include <memory>
 #include <mutex>
 #include <net/ethernet.h>
 #include <netinet/in.h>
 #include <netinet/ip.h>
 #include <netinet/tcp.h>
 #include <pcap.h>
-#include <set>
 #include <sys/types.h>
 #include <vector>
 
+// Параметры детекторов одного воркера
+struct DetectorConfig {
+  // Память всех воркеров под состояние детекторов; 0 - размеры таблиц
+  // задаются max_* напрямую, иначе выводятся из бюджета (fitBudget)
+  uint64_t memory_budget = 0;
+  uint32_t max_sources = 1 << 16; // записей в таблице источников
+  uint32_t max_scans = 1 << 14;   // источников, у которых считается скан
+  uint32_t block_ttl = 600;       // сколько секунд адрес держится в пуле
+  uint32_t max_blocked = 1 << 14; // адресов в пуле блокировки
+  uint32_t max_targets = 4096;    // адресов и портов назначения
+  uint32_t max_flows = 1 << 17;   // потоков TCP в таблице рукопожатий
+  uint32_t alert_queue = 4096;    // алертов в очереди к главному циклу
+  uint32_t handshake_timeout = 30; // секунд на завершение рукопожатия
+  uint32_t flow_timeout = 300;     // простой установленного потока
+
+  // Флуд-детекторы: "exact" - счётчики в записи источника, "sketch" -
+  // Count-Min Sketch и top-K с памятью, не зависящей от числа источников
+  // (для флудов с подменой адресов), "kernel" - счётчики XDP-программы
+  // (kernelflood), пороги проверяются раз в окно
+  std::string flood_mode = "exact";
+  uint32_t sketch_width = 4096;
+  uint32_t sketch_depth = 4;
+  uint32_t top_k = 32;
+  uint32_t kernel_entries = 1 << 16; // источников в карте ядра на окно
+  uint32_t flood_volume = 10000; // пакетов одного типа за окно - алерт
+};
+
 class firewall {
 public:
+  // Алерт для главного цикла: AlertRecord из очереди с готовыми
+  // строками
   struct AttackInfo {
     std::string type;
     std::string source_ip;
     int count;
     time_t timestamp;
+    uint32_t ip = 0;     // сетевой порядок
+    bool target = false; // ip - адрес жертвы, а не источника
+    AttackType kind = ATTACK_TYPES;
+    uint8_t length = 32; // ip - префикс этой длины (ATTACK_SUBNET)
+  };
+
+  // Адрес, впервые попавший в пул блокировки, или префикс, в который
+  // свернулись такие адреса (trafficmonitor)
+  struct BlockInfo {
+    uint32_t ip;    // сетевой порядок
+    uint32_t since; // секунды
+    uint8_t length = 32;
+  };
+
+  // Пишет только поток-владелец, читает медленный путь сбора статистики
+  struct Counters {
+    std::atomic<uint64_t> packets{0};
+    std::atomic<uint64_t> ipv4{0};
+    std::atomic<uint64_t> alerts{0};
+    std::atomic<uint64_t> table_full{0}; // источник не допущен в таблицу
+    std::atomic<uint64_t> targets_full{0}; // без места под адрес назначения
+    std::atomic<uint64_t> allowed{0}; // пропущены по allow-списку
+    std::atomic<uint64_t> denied{0};  // отброшены по deny-списку
+    std::atomic<uint64_t> flows_full{0}; // SYN без места под поток
+    std::atomic<uint64_t> scans_full{0}; // пробы без места под скан
+    std::atomic<uint64_t> evictions{0};  // записей вытеснено из таблиц
+    // новые блокировки, не дождавшиеся главного цикла сверх max_blocked
+    std::atomic<uint64_t> blocks_dropped{0};
+    // Занятость таблиц, обновляется раз в пачку
+    std::atomic<uint64_t> sources_used{0};
+    std::atomic<uint64_t> targets_used{0};
+    std::atomic<uint64_t> flows_used{0};
+    std::atomic<uint64_t> scans_used{0};
+
+    static void bump(std::atomic<uint64_t> &counter) {
+      counter.store(counter.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+    }
   };
 
-  firewall();
-  static void analyzePacket(const u_char *packet,
-                            const struct pcap_pkthdr *header);
+  // Каждый воркер захвата владеет своим экземпляром: источник всегда
+  // попадает в один и тот же воркер, поэтому состояние не делится.
+  explicit firewall(const DetectorConfig &limits = DetectorConfig());
+  // Размеры таблиц, при которых состояние воркера укладывается в bytes
+  static DetectorConfig fitBudget(DetectorConfig config, uint64_t bytes);
+  void analyzePacket(const u_char *packet, const struct pcap_pkthdr *header);
+  void analyzeBatch(const PacketBatch &batch);
+  void idle(); // бэкенд без пакетов: таймеры истекают и без трафика
+  // Новая таблица правил; воркер подхватит её в начале следующей пачки
+  void setRules(std::shared_ptr<const ruletable> rules);
+  static uint32_t supportedDetectors(); // детекторы, собранные в сборке
+  void setClock(std::unique_ptr<detectorclock> clock);
+  // Число воркеров в fanout-группе: каждый видит свою долю источников
+  // жертвы, и оценки на стороне жертвы умножаются на него
+  void setFanout(uint32_t workers);
+  // Режим kernel: карту читает один воркер, у остальных флуд-детекторы
+  // просто не работают
+  void setKernelCounters(std::unique_ptr<kernelflood> counters);
 
-  static std::vector<AttackInfo> getDetectedAttacks();
-  static void clearDetectedAttacks();
+  // Алерты уходят в очередь, общую для воркеров (trafficmonitor); без
+  // неё у экземпляра своя
+  void setAlertQueue(std::shared_ptr<alertqueue> queue);
+  alertqueue &alerts() { return *alert_queue; }
+  std::vector<BlockInfo> takeBlockedSources();
+  const Counters &counters() const { return stats; }
 
 private:
-  static void cleanupOldEntries(std::map<uint32_t, int> &attempts,
-                                std::map<uint32_t, time_t> &timestamps,
-                                time_t timeout);
-  static void checkFloodAttack(uint32_t src_ip,
-                               std::map<uint32_t, int> &count_map,
-                               int threshold, const std::string &attack_name);
-
-  static std::vector<AttackInfo> detected_attacks;
-  static std::mutex attacks_mutex;
-  static time_t last_reset_time;
-  static std::set<uint32_t> SYNatack_ip_pool;
+  enum TimerKind : uint32_t { SOURCE_TIMER, TARGET_TIMER };
+
+  // Всё состояние одного источника в одной кэш-линии: пакет обновляет
+  // любые детекторы за один поиск в таблице. Окна детекторов SSH и скана
+  // задаются в секундах.
+  struct alignas(64) SourceState {
+    uint32_t key;       // IPv4 источника, сетевой порядок
+    uint32_t scan;      // индекс в scans + 1, 0 - проб не было
+    uint32_t last_seen; // секунды
+    // Скользящее окно флуда: пакеты текущего и предыдущего окна
+    uint32_t epoch;     // номер текущего окна флуда
+    uint16_t flood[FLOOD_KINDS];
+    uint16_t flood_prev[FLOOD_KINDS];
+    uint16_t ssh_connect;
+    uint16_t ssh_bruteforce;
+    uint32_t ssh_connect_time;
+    uint32_t ssh_bruteforce_time;
+    uint8_t alerted;    // по биту на FloodKind, сбрасывается с окном
+    bool referenced;
+    bool used;
+    uint32_t timer;     // поколение своего таймера
+  };
+  static_assert(sizeof(SourceState) == 64, "SourceState must fit a line");
+
+  // Состояние детектора сканов живёт вне записи: оно нужно только
+  // источникам, шлющим пробы без ACK. Размер фиксирован, число записей
+  // ограничено размером таблицы источников.
+  struct ScanState {
+    distinctcounter ports; // вертикальный скан: порты любых адресов
+    distinctcounter hosts; // горизонтальный: адреса с портом host_port
+    uint32_t start;        // начало окна, секунды
+    uint16_t host_port;    // порт первой пробы в окне
+  };
+
+  // Флуд на адрес назначения от всех источников сразу. Ключ - адрес в
+  // старших 32 битах и порт + 1 в младших; 0 - адрес целиком.
+  // Рукопожатия считаются только для адреса с портом.
+  enum TargetAlert : uint8_t { TARGET_ALERT = 1, HALF_OPEN_ALERT = 2 };
+  struct alignas(64) TargetState {
+    uint64_t key;
+    distinctcounter sources; // различные источники текущего окна
+    uint32_t epoch;
+    uint32_t packets;
+    uint32_t packets_prev;
+    uint32_t last_seen;  // секунды
+    uint32_t handshakes; // начатых за окно
+    uint32_t completed;  // завершённых за окно
+    uint32_t half_open;  // сейчас в таблице потоков, не за окно
+    uint8_t alerted;     // биты TargetAlert, сбрасываются с окном
+    bool referenced;
+    bool used;
+    uint32_t timer;      // поколение своего таймера
+  };
+  static_assert(sizeof(TargetState) == 128, "TargetState must fit 2 lines");
+
+  // Адрес в пуле блокировки. Срок хранится в записи и истекает обходом
+  // таблицы порциями, как в flowtable: подменённые адреса не копят
+  // таймеры в колесе.
+  struct BlockState {
+    uint32_t key;       // IPv4, сетевой порядок
+    uint32_t until;     // секунды
+    uint32_t mitigated; // до когда держится запись в nftables и XDP
+    bool referenced;
+    bool used;
+  };
+
+  void rollWindow(SourceState &source, EventTime window, EventTime now);
+  // Контекст одного пакета для детекторов конвейера (detectors.h): через
+  // него детекторы обновляют состояние источника
+  class PacketContext {
+  public:
+    PacketContext(firewall &owner, const PacketView &packet, const Rule &rule)
+        : owner(owner), packet(packet), rule(rule) {}
+
+    void flood(FloodKind kind);
+    void portScan();
+    void ssh();
+    void target();
+    void flow();
+
+  private:
+    SourceState *state();
+
+    firewall &owner;
+    const PacketView &packet;
+    const Rule &rule;
+    SourceState *source = nullptr;
+    bool looked_up = false;
+  };
+
+  void checkFloodAttack(SourceState &source, FloodKind kind,
+                        const Thresholds &limits, EventTime now);
+  void checkFloodSketch(FloodKind kind, uint32_t src_ip);
+  void checkKernelFlood();
+  void checkPortScan(SourceState &source, uint32_t dst_ip, uint16_t port,
+                     const Thresholds &limits, EventTime now);
+  void checkSsh(SourceState &source, uint8_t flags, const Thresholds &limits,
+                EventTime now);
+  TargetState *targetState(uint64_t key, const Thresholds &limits,
+                           EventTime now);
+  void checkTarget(uint64_t key, uint32_t src_ip, const Thresholds &limits,
+                   EventTime now);
+  void checkHalfOpen(const FlowKey &flow, FlowChange change, EventTime now);
+  void releaseHalfOpen(const FlowKey &flow);
+  void refreshRules();
+  void publishOccupancy();
+  void expireTimers(size_t budget);
+  void expireIdle();
+  void expireTimer(const timerwheel::Timer &timer, EventTime now);
+  void blockSource(uint32_t ip, EventTime now);
+  void releaseScan(SourceState &source);
+  void reportAttack(AttackType type, uint32_t ip, uint32_t count,
+                    EventTime now, bool target = false);
+
+  // Заполненные таблицы источников и адресов вытесняют записи по CLOCK,
+  // но только ради ключа, который встречался чаще жертвы (TinyLFU):
+  // поток новых подменённых адресов не выбивает постоянных источников
+  sourcetable<SourceState> sources;
+  frequencysketch source_frequency;
+  std::vector<ScanState> scans; // пул на max_scans записей
+  std::vector<uint32_t> free_scans;
+  uint32_t max_scans;
+  uint64_t evicted = 0;
+  // У каждой записи источника и адреса назначения ровно один живой
+  // таймер. Вытесненная запись свой таймер не снимает: он несёт
+  // поколение записи и, не совпав с поколением новой записи того же
+  // ключа, просто выбывает при срабатывании.
+  timerwheel timers{USEC_PER_SEC};
+  uint32_t timer_generation = 0;
+  EventTime next_expiry = 0; // следующий полный проход по часам
+  uint32_t source_idle;
+  uint32_t block_ttl;
+
+  sourcetable<TargetState> targets;
+  frequencysketch target_frequency;
+  uint32_t fanout = 1;
+  flowtable flows;
+
+  // Режим sketch: по скетчу и своему окну на каждый тип флуда
+  std::vector<std::unique_ptr<floodsketch>> sketches;
+  EventTime sketch_window[FLOOD_KINDS] = {};
+  uint32_t flood_volume;
+
+  // Режим kernel: у воркера с картой - окно и буфер сумм
+  bool kernel_flood;
+  std::unique_ptr<kernelflood> kernel;
+  EventTime kernel_window = 0;
+  std::vector<kernelflood::Totals> kernel_totals;
+
+  // Правила публикуются как неизменяемая таблица (RCU): setRules кладёт
+  // новую в pending и поднимает версию, воркер забирает её между
+  // пачками. Старая таблица освобождается с последней ссылкой на неё.
+  std::atomic<std::shared_ptr<const ruletable>> pending_rules;
+  std::atomic<uint64_t> rules_version{0};
+  uint64_t applied_version = 0;
+  std::shared_ptr<const ruletable> rules; // читает только воркер
+
+  std::shared_ptr<alertqueue> alert_queue;
+  std::vector<BlockInfo> blocked_sources; // не больше max_blocked
+  std::mutex attacks_mutex; // blocked_sources
+  std::unique_ptr<detectorclock> clock;
+  // Пул блокировки: заполненный забывает адрес по CLOCK
+  sourcetable<BlockState> block_pool;
+  size_t block_cursor = 0;
+  uint32_t max_blocked;
+  Counters stats;
 };
 
 #endif // FIREWALL_H
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include "floodsketch.h"
+#include <algorithm>
+
+static uint32_t roundUpPow2(uint32_t value) {
+  uint32_t size = 1;
+  while (size < value) {
+    size <<= 1;
+  }
+  return size;
+}
+
+floodsketch::floodsketch(uint32_t width, uint32_t depth, uint32_t top_k)
+    : width_mask(roundUpPow2(std::max(width, 64u)) - 1),
+      depth(std::clamp(depth, 1u, 8u)), top_k(std::max(top_k, 1u)),
+      candidates(size_t(this->top_k) * 2) {
+  counters.assign(size_t(width_mask + 1) * this->depth, 0);
+}
+
+void floodsketch::reset() {
+  std::fill(counters.begin(), counters.end(), 0);
+  candidates.clear();
+  min_key = 0;
+  min_count = 0;
+  packets = 0;
+}
+
+// Консервативное обновление: растут только счётчики, равные минимуму,
+// поэтому коллизии завышают оценку меньше, чем у обычного CMS
+uint32_t floodsketch::update(uint32_t ip) {
+  uint32_t *cells[8];
+  uint32_t estimate = UINT32_MAX;
+  for (uint32_t row = 0; row < depth; ++row) {
+    uint32_t h = mix32(ip ^ (0x9e3779b9u * (row + 1)));
+    cells[row] = &counters[size_t(row) * (width_mask + 1) + (h & width_mask)];
+    estimate = std::min(estimate, *cells[row]);
+  }
+  if (estimate == UINT32_MAX) {
+    return estimate;
+  }
+  ++estimate;
+  for (uint32_t row = 0; row < depth; ++row) {
+    if (*cells[row] < estimate) {
+      *cells[row] = estimate;
+    }
+  }
+  return estimate;
+}
+
+void floodsketch::findMinimum() {
+  min_count = UINT32_MAX;
+  candidates.forEach([&](Candidate &candidate) {
+    if (candidate.count < min_count) {
+      min_count = candidate.count;
+      min_key = candidate.key;
+    }
+  });
+}
+
+void floodsketch::add(uint32_t ip) {
+  ++packets;
+  uint32_t estimate = update(ip);
+
+  if (Candidate *candidate = candidates.find(ip)) {
+    candidate->count = estimate;
+    if (ip == min_key) {
+      findMinimum();
+    }
+    return;
+  }
+
+  if (candidates.size() < top_k) {
+    Candidate *candidate = candidates.findOrInsert(ip);
+    candidate->count = estimate;
+    if (candidates.size() == 1 || estimate < min_count) {
+      min_count = estimate;
+      min_key = ip;
+    }
+    return;
+  }
+
+  // Вытесняем самого слабого кандидата, только если новый адрес по
+  // оценке скетча уже тяжелее него - обычный подменённый адрес сюда
+  // не доходит
+  if (estimate > min_count) {
+    candidates.erase(candidates.find(min_key));
+    candidates.findOrInsert(ip)->count = estimate;
+    findMinimum();
+  }
+}
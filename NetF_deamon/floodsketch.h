@@ -0,0 +1,60 @@
+#ifndef FLOODSKETCH_H
+#define FLOODSKETCH_H
+
+#include "sourcetable.h"
+#include <cstdint>
+#include <vector>
+
+// Счётчик флуда за окно с памятью, не зависящей от числа источников.
+// Count-Min Sketch с консервативным обновлением оценивает число пакетов
+// любого адреса сверху; top-K кандидатов (Space-Saving поверх оценок
+// скетча) хранит адреса с наибольшими оценками. При флуде с подменой
+// адресов каждый новый адрес стоит depth инкрементов и одно сравнение.
+class floodsketch {
+public:
+  floodsketch(uint32_t width, uint32_t depth, uint32_t top_k);
+
+  void add(uint32_t ip);
+  void reset();
+
+  uint64_t total() const { return packets; }
+
+  // Граница ошибки CMS: оценка превышает истинное значение не больше
+  // чем на e * N / width (с вероятностью 1 - e^-depth)
+  uint64_t errorBound() const {
+    return uint64_t(packets * 2.718281828 / (width_mask + 1));
+  }
+
+  // Кандидаты, которые выше порога даже за вычетом ошибки скетча:
+  // при большом объёме подменённых адресов шум в ячейках не должен
+  // выдавать случайный адрес за источник флуда
+  template <typename Fn> void forEachHeavy(uint32_t threshold, Fn fn) {
+    const uint64_t floor = threshold + errorBound();
+    candidates.forEach([&](Candidate &candidate) {
+      if (candidate.count > floor) {
+        fn(candidate.key, candidate.count);
+      }
+    });
+  }
+
+private:
+  struct Candidate {
+    uint32_t key;
+    uint32_t count;
+    bool used;
+  };
+
+  uint32_t update(uint32_t ip);
+  void findMinimum();
+
+  std::vector<uint32_t> counters; // depth строк по width счётчиков
+  uint32_t width_mask;
+  uint32_t depth;
+  uint32_t top_k;
+  sourcetable<Candidate> candidates;
+  uint32_t min_key = 0;
+  uint32_t min_count = 0;
+  uint64_t packets = 0;
+};
+
+#endif // FLOODSKETCH_H
@@ -0,0 +1,79 @@
+#include "flowtable.h"
+#include <netinet/tcp.h>
+
+FlowChange flowtable::update(const PacketView &packet, uint32_t seconds,
+                             FlowKey &key,
+                             std::optional<FlowKey> &abandoned) {
+  const uint8_t flags = packet.tcp_flags;
+  // FIN или RST: полуоткрытый поток считается сорванным
+  auto close = [&](Flow &flow) {
+    const bool half_open = flow.phase < FLOW_ESTABLISHED;
+    flow.referenced = true;
+    flow.phase = FLOW_CLOSED;
+    flow.deadline = seconds + closed_timeout;
+    return half_open ? FlowChange::ABORTED : FlowChange::NONE;
+  };
+
+  if ((flags & (TH_SYN | TH_ACK)) == (TH_SYN | TH_ACK)) {
+    // Ответ сервера: поток записан со стороны клиента
+    key = {packet.dst_ip, packet.src_ip, packet.dport, packet.sport};
+    Flow *flow = flows.find(key);
+    if (flow && flow->phase == FLOW_SYN) {
+      flow->phase = FLOW_SYN_ACK;
+      flow->referenced = true;
+    }
+    return FlowChange::NONE;
+  }
+  if ((flags & (TH_RST | TH_ACK)) == (TH_RST | TH_ACK)) {
+    // RST-ACK сервера, например закрытый порт в ответ на SYN. Не
+    // найден - это сброс со стороны клиента, разбираем ниже.
+    key = {packet.dst_ip, packet.src_ip, packet.dport, packet.sport};
+    Flow *flow = flows.find(key);
+    if (flow && flow->phase != FLOW_CLOSED) {
+      return close(*flow);
+    }
+  }
+
+  key = {packet.src_ip, packet.dst_ip, packet.sport, packet.dport};
+  if (flags & TH_SYN) {
+    Flow *flow = flows.findOrReplace(key, [&](const Flow &victim) {
+      if (victim.phase == FLOW_ESTABLISHED) {
+        return false;
+      }
+      if (victim.phase != FLOW_CLOSED) {
+        abandoned = victim.key;
+      }
+      ++evicted;
+      return true;
+    });
+    if (!flow) {
+      return FlowChange::FULL;
+    }
+    flow->referenced = true;
+    // Повтор SYN не открывает поток заново, SYN после закрытия - открывает
+    if (flow->deadline != 0 && flow->phase != FLOW_CLOSED) {
+      return FlowChange::NONE;
+    }
+    flow->phase = FLOW_SYN;
+    flow->deadline = seconds + handshake_timeout;
+    return FlowChange::OPENED;
+  }
+
+  Flow *flow = flows.find(key);
+  if (!flow || flow->phase == FLOW_CLOSED) {
+    return FlowChange::NONE;
+  }
+  if (flags & (TH_FIN | TH_RST)) {
+    return close(*flow);
+  }
+  flow->referenced = true;
+  if (flags & TH_ACK) {
+    // SYN-ACK мог пройти мимо интерфейса: ACK клиента и так
+    // подтверждает рукопожатие
+    const bool completed = flow->phase < FLOW_ESTABLISHED;
+    flow->phase = FLOW_ESTABLISHED;
+    flow->deadline = seconds + idle_timeout;
+    return completed ? FlowChange::ESTABLISHED : FlowChange::NONE;
+  }
+  return FlowChange::NONE;
+}
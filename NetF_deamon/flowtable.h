@@ -0,0 +1,101 @@
+#ifndef FLOWTABLE_H
+#define FLOWTABLE_H
+
+#include "detectorpipeline.h"
+#include "sourcetable.h"
+#include <cstdint>
+#include <optional>
+
+// Поток TCP с точки зрения клиента - того, кто прислал SYN
+struct FlowKey {
+  uint32_t client; // сетевой порядок
+  uint32_t server;
+  uint16_t client_port; // порядок хоста
+  uint16_t server_port;
+
+  bool operator==(const FlowKey &) const = default;
+};
+
+inline size_t hashKey(const FlowKey &key) {
+  return mix64((uint64_t(key.client) << 32 | key.server) ^
+               (uint64_t(key.client_port) << 16 | key.server_port) *
+                   0x9e3779b97f4a7c15ULL);
+}
+
+enum FlowPhase : uint8_t {
+  FLOW_SYN,         // клиент прислал SYN
+  FLOW_SYN_ACK,     // сервер ответил
+  FLOW_ESTABLISHED, // клиент подтвердил ответ
+  FLOW_CLOSED,      // FIN или RST; запись доживает короткий срок
+};
+
+// Что сегмент изменил в рукопожатии потока
+enum class FlowChange : uint8_t {
+  NONE,
+  OPENED,      // новый полуоткрытый поток
+  ESTABLISHED, // рукопожатие завершено
+  ABORTED,     // полуоткрытый поток закрыт FIN/RST любой стороны
+  FULL,        // таблица занята установленными потоками
+};
+
+// Таблица потоков с открытой адресацией. Срок жизни хранится прямо в
+// записи, отдельных таймеров нет: expire обходит таблицу по кругу
+// порциями и удаляет просроченные записи. Отслеживается только
+// рукопожатие и факт закрытия, номера последовательностей не
+// проверяются.
+//
+// Fanout отправляет SYN-ACK и RST-ACK воркеру клиента (ringcapture),
+// поэтому все сегменты рукопожатия одного потока, включая отказ
+// закрытого порта, видит один воркер.
+//
+// В заполненной таблице новый SYN вытесняет по CLOCK полуоткрытый или
+// закрытый поток; установленные потоки SYN-флуд не вытесняет.
+class flowtable {
+public:
+  struct Flow {
+    FlowKey key;
+    uint32_t deadline; // секунды
+    FlowPhase phase;
+    bool referenced;
+    bool used;
+  };
+
+  flowtable(size_t capacity, uint32_t handshake_timeout,
+            uint32_t idle_timeout)
+      : flows(capacity), handshake_timeout(handshake_timeout),
+        idle_timeout(idle_timeout) {}
+
+  // key - поток сегмента, когда он найден или создан; abandoned -
+  // полуоткрытый поток, вытесненный ради нового
+  FlowChange update(const PacketView &packet, uint32_t seconds,
+                    FlowKey &key, std::optional<FlowKey> &abandoned);
+
+  // Просроченные полуоткрытые потоки отдаются в abandoned
+  template <typename Fn>
+  void expire(uint32_t seconds, size_t budget, Fn abandoned) {
+    flows.sweep(cursor, budget, [&](Flow &flow) {
+      if (seconds <= flow.deadline) {
+        return false;
+      }
+      if (flow.phase < FLOW_ESTABLISHED) {
+        abandoned(flow.key);
+      }
+      return true;
+    });
+  }
+
+  size_t size() const { return flows.size(); }
+  size_t memory() const { return flows.capacity() * sizeof(Flow); }
+  uint64_t evictions() const { return evicted; }
+
+private:
+  static constexpr uint32_t closed_timeout = 10;
+
+  sourcetable<Flow> flows;
+  uint32_t handshake_timeout;
+  uint32_t idle_timeout;
+  size_t cursor = 0;
+  uint64_t evicted = 0;
+};
+
+#endif // FLOWTABLE_H
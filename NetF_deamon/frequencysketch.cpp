@@ -0,0 +1,84 @@
+#include "frequencysketch.h"
+#include "sourcetable.h"
+#include <algorithm>
+
+frequencysketch::frequencysketch(size_t capacity) {
+  size_t size = 64;
+  while (size < capacity) {
+    size <<= 1;
+  }
+  // По 4 счётчика и 32 бита привратника на запись таблицы: за период
+  // в 4 записи на слот в привратник попадает не больше 1/4 бит, и
+  // одноразовые ключи редко выдают себя за повторные
+  counters.assign(size * 4 / 16, 0);
+  doorkeeper.assign(size * 32 / 64, 0);
+  counter_mask = size * 4 - 1;
+  door_mask = size * 32 - 1;
+  sample = uint32_t(std::min<size_t>(size * 4, UINT32_MAX));
+}
+
+// Индексы строк - двойным хэшированием из одного mix64
+static uint64_t probe(uint64_t hash, int row) {
+  return hash + row * ((hash >> 32) | 1);
+}
+
+bool frequencysketch::remember(uint64_t hash) {
+  bool seen = true;
+  for (int row = 0; row < 2; ++row) {
+    uint64_t bit = (probe(hash, row) >> 7) & door_mask;
+    uint64_t mask = uint64_t(1) << (bit & 63);
+    if (!(doorkeeper[bit >> 6] & mask)) {
+      doorkeeper[bit >> 6] |= mask;
+      seen = false;
+    }
+  }
+  return seen;
+}
+
+bool frequencysketch::remembered(uint64_t hash) const {
+  for (int row = 0; row < 2; ++row) {
+    uint64_t bit = (probe(hash, row) >> 7) & door_mask;
+    if (!(doorkeeper[bit >> 6] & (uint64_t(1) << (bit & 63)))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void frequencysketch::record(uint64_t key) {
+  const uint64_t hash = mix64(key);
+  if (remember(hash)) {
+    for (int row = 0; row < depth; ++row) {
+      uint64_t index = probe(hash, row + 2) & counter_mask;
+      uint64_t &word = counters[index >> 4];
+      const int shift = (index & 15) * 4;
+      if (((word >> shift) & 15) < 15) {
+        word += uint64_t(1) << shift;
+      }
+    }
+  }
+  if (++additions >= sample) {
+    age();
+  }
+}
+
+uint32_t frequencysketch::estimate(uint64_t key) const {
+  const uint64_t hash = mix64(key);
+  uint32_t count = 15;
+  for (int row = 0; row < depth; ++row) {
+    uint64_t index = probe(hash, row + 2) & counter_mask;
+    const int shift = (index & 15) * 4;
+    count = std::min<uint32_t>(count, (counters[index >> 4] >> shift) & 15);
+  }
+  // Очистка привратника при старении не обнуляет частых: их счётчики
+  // только делятся пополам
+  return count + remembered(hash);
+}
+
+void frequencysketch::age() {
+  for (uint64_t &word : counters) {
+    word = (word >> 1) & 0x7777777777777777ULL;
+  }
+  std::fill(doorkeeper.begin(), doorkeeper.end(), 0);
+  additions /= 2;
+}
@@ -0,0 +1,47 @@
+#ifndef FREQUENCYSKETCH_H
+#define FREQUENCYSKETCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Оценка частоты ключей для допуска в заполненную таблицу (TinyLFU).
+// Первое появление ключа отмечается только в фильтре-привратнике
+// (doorkeeper), счётчики Count-Min растут со второго: поток одноразовых
+// подменённых адресов не размывает оценки постоянных источников.
+// Счётчики 4-битные, по 16 в слове; каждые sample обращений все они
+// делятся пополам, а привратник очищается - старая активность
+// забывается.
+class frequencysketch {
+public:
+  // capacity - число записей таблицы, которую сторожит скетч
+  explicit frequencysketch(size_t capacity);
+
+  void record(uint64_t key);
+  uint32_t estimate(uint64_t key) const;
+
+  // Новый ключ вытесняет жертву, только если встречался чаще неё
+  bool admits(uint64_t candidate, uint64_t victim) const {
+    return estimate(candidate) > estimate(victim);
+  }
+
+  size_t memory() const {
+    return (counters.size() + doorkeeper.size()) * sizeof(uint64_t);
+  }
+
+private:
+  static constexpr int depth = 4;
+
+  bool remember(uint64_t hash); // false - ключ в привратнике впервые
+  bool remembered(uint64_t hash) const;
+  void age();
+
+  std::vector<uint64_t> counters;   // 4-битные счётчики
+  std::vector<uint64_t> doorkeeper; // фильтр Блума, 2 пробы на ключ
+  uint64_t counter_mask;            // номер счётчика
+  uint64_t door_mask;               // номер бита привратника
+  uint32_t additions = 0;
+  uint32_t sample;
+};
+
+#endif // FREQUENCYSKETCH_H
@@ -0,0 +1,74 @@
+#include "incidenttable.h"
+#include <algorithm>
+
+incidenttable::incidenttable(const IncidentConfig &config) : config(config) {}
+
+void incidenttable::observe(const firewall::AttackInfo &attack,
+                            std::vector<Event> &events) {
+  const uint32_t seen = attack.timestamp;
+  const uint32_t count = std::max(attack.count, 0);
+  clock = std::max(clock, seen);
+
+  auto it = incidents.find({attack.kind, attack.source_ip});
+  if (it == incidents.end()) {
+    if (incidents.size() >= config.max_incidents) {
+      rejected_alerts++;
+      return;
+    }
+    Incident incident = {};
+    incident.id = next_id++;
+    incident.type = attack.kind;
+    incident.address = attack.source_ip;
+    incident.ip = attack.ip;
+    incident.length = attack.length;
+    incident.target = attack.target;
+    incident.opened = incident.last_seen = incident.emitted = seen;
+    incident.alerts = 1;
+    incident.count = incident.peak = count;
+    incidents.emplace(Key{attack.kind, attack.source_ip}, incident);
+    events.push_back({Phase::OPEN, incident});
+    return;
+  }
+
+  // Воркеры шлют алерты не строго по времени, а expire двигает emitted
+  // до часов системы: запоздавший алерт не должен уйти в минус
+  Incident &incident = it->second;
+  const uint32_t at = std::max(seen, incident.emitted);
+  incident.last_seen = std::max(incident.last_seen, seen);
+  incident.alerts++;
+  incident.count = count;
+  incident.peak = std::max(incident.peak, count);
+  if (at - incident.emitted >= config.update_interval) {
+    incident.emitted = at;
+    incident.pending = false;
+    events.push_back({Phase::UPDATE, incident});
+  } else {
+    incident.pending = true;
+    merged_alerts++;
+  }
+}
+
+void incidenttable::expire(uint32_t now, std::vector<Event> &events) {
+  now = std::max(now, clock);
+  for (auto it = incidents.begin(); it != incidents.end();) {
+    Incident &incident = it->second;
+    if (now - incident.last_seen >= config.close_after) {
+      events.push_back({Phase::CLOSE, incident});
+      it = incidents.erase(it);
+      continue;
+    }
+    if (incident.pending && now - incident.emitted >= config.update_interval) {
+      incident.emitted = now;
+      incident.pending = false;
+      events.push_back({Phase::UPDATE, incident});
+    }
+    ++it;
+  }
+}
+
+void incidenttable::closeAll(std::vector<Event> &events) {
+  for (const auto &[key, incident] : incidents) {
+    events.push_back({Phase::CLOSE, incident});
+  }
+  incidents.clear();
+}
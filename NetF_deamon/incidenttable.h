@@ -0,0 +1,73 @@
+#ifndef INCIDENTTABLE_H
+#define INCIDENTTABLE_H
+
+#include "firewall.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct IncidentConfig {
+  uint32_t update_interval = 10; // секунд между обновлениями инцидента
+  uint32_t close_after = 60;     // секунд без алертов до закрытия
+  uint32_t max_incidents = 4096; // открытых одновременно
+};
+
+// Инциденты: повторные алерты одного типа об одном адресе (флуд
+// перепроверяется каждое окно, SSH - каждые limit попыток) сливаются в
+// одну запись. Наружу уходят открытие, обновления не чаще
+// update_interval и закрытие после close_after тишины, так что поток
+// событий растёт с числом атак, а не с их длительностью.
+//
+// Время - время алертов, как у prefixaggregator: в replay инциденты
+// живут по файлу. Только главный поток.
+class incidenttable {
+public:
+  enum class Phase : uint8_t { OPEN, UPDATE, CLOSE };
+
+  struct Incident {
+    uint64_t id;
+    AttackType type;
+    std::string address; // адрес или префикс, как в AttackInfo
+    uint32_t ip;         // сетевой порядок
+    uint8_t length;      // префикса, 32 - адрес
+    bool target;
+    uint32_t opened;    // секунды
+    uint32_t last_seen; // последний алерт
+    uint32_t emitted;   // последнее событие наружу
+    uint32_t alerts;    // алертов слито в инцидент
+    uint32_t count;     // счётчик последнего алерта
+    uint32_t peak;      // наибольший счётчик
+    bool pending;       // есть изменения после последнего события
+  };
+
+  struct Event {
+    Phase phase;
+    Incident incident;
+  };
+
+  explicit incidenttable(const IncidentConfig &config = IncidentConfig());
+
+  void observe(const firewall::AttackInfo &attack, std::vector<Event> &events);
+  // Отложенные обновления и закрытия; now - часы системы или 0, если
+  // время идёт только по алертам (replay)
+  void expire(uint32_t now, std::vector<Event> &events);
+  void closeAll(std::vector<Event> &events); // при остановке
+
+  size_t size() const { return incidents.size(); }
+  uint64_t merged() const { return merged_alerts; }   // не ушли наружу
+  uint64_t rejected() const { return rejected_alerts; } // таблица полна
+
+private:
+  using Key = std::pair<AttackType, std::string>;
+
+  IncidentConfig config;
+  std::map<Key, Incident> incidents;
+  uint64_t next_id = 1;
+  uint32_t clock = 0; // самый поздний алерт
+  uint64_t merged_alerts = 0;
+  uint64_t rejected_alerts = 0;
+};
+
+#endif // INCIDENTTABLE_H
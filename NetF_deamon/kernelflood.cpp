@@ -0,0 +1,237 @@
+#include "kernelflood.h"
+#include "ebpf.h"
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <linux/if_link.h>
+#include <net/ethernet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+
+kernelflood::kernelflood(uint32_t max_entries)
+    : max_entries(max_entries), cpus(ebpf::possibleCpus()), per_cpu(cpus) {}
+
+kernelflood::~kernelflood() { detach(); }
+
+// Классы - как в detectors.h и bpfprefilter: TCP без первого фрагмента
+// не разбирается, FIN-пакет Xmas-скана считается и как FIN. Программа
+// ничего не отбрасывает.
+int kernelflood::buildProgram(std::string &log) {
+  using e = ebpf;
+  std::vector<bpf_insn> code;
+  std::vector<size_t> to_pass;  // переходы на XDP_PASS
+  std::vector<size_t> to_count; // переходы на учёт по маске в r8
+
+  const int16_t ip = sizeof(struct ether_header);
+  code.push_back(e::load(BPF_W, BPF_REG_2, BPF_REG_1, 0)); // data
+  code.push_back(e::load(BPF_W, BPF_REG_3, BPF_REG_1, 4)); // data_end
+  code.push_back(e::mov(BPF_REG_4, BPF_REG_2));
+  code.push_back(e::aluImm(BPF_ADD, BPF_REG_4, ip + 20));
+  to_pass.push_back(code.size());
+  code.push_back(e::jumpReg(BPF_JGT, BPF_REG_4, BPF_REG_3, 0));
+  code.push_back(e::load(BPF_H, BPF_REG_4, BPF_REG_2, 12));
+  to_pass.push_back(code.size());
+  code.push_back(e::jumpImm(BPF_JNE, BPF_REG_4, htons(ETHERTYPE_IP), 0));
+
+  // r7 - источник, r8 - маска классов FloodKind
+  code.push_back(e::load(BPF_W, BPF_REG_7, BPF_REG_2, ip + 12));
+  code.push_back(e::load(BPF_B, BPF_REG_4, BPF_REG_2, ip + 9));
+  for (auto [protocol, kind] : {std::pair{IPPROTO_UDP, FLOOD_UDP},
+                                std::pair{IPPROTO_ICMP, FLOOD_ICMP}}) {
+    code.push_back(e::jumpImm(BPF_JNE, BPF_REG_4, protocol, 2));
+    code.push_back(e::movImm(BPF_REG_8, 1 << kind));
+    to_count.push_back(code.size());
+    code.push_back(e::jumpImm(BPF_JA, 0, 0, 0));
+  }
+  to_pass.push_back(code.size());
+  code.push_back(e::jumpImm(BPF_JNE, BPF_REG_4, IPPROTO_TCP, 0));
+  code.push_back(e::load(BPF_H, BPF_REG_4, BPF_REG_2, ip + 6));
+  code.push_back(e::aluImm(BPF_AND, BPF_REG_4, htons(0x1fff)));
+  to_pass.push_back(code.size());
+  code.push_back(e::jumpImm(BPF_JNE, BPF_REG_4, 0, 0));
+  code.push_back(e::load(BPF_B, BPF_REG_4, BPF_REG_2, ip));
+  code.push_back(e::aluImm(BPF_AND, BPF_REG_4, 0x0f));
+  code.push_back(e::aluImm(BPF_LSH, BPF_REG_4, 2));
+  code.push_back(e::alu(BPF_ADD, BPF_REG_2, BPF_REG_4));
+  code.push_back(e::mov(BPF_REG_4, BPF_REG_2));
+  code.push_back(e::aluImm(BPF_ADD, BPF_REG_4, ip + sizeof(struct tcphdr)));
+  to_pass.push_back(code.size());
+  code.push_back(e::jumpReg(BPF_JGT, BPF_REG_4, BPF_REG_3, 0));
+  code.push_back(e::load(BPF_B, BPF_REG_5, BPF_REG_2, ip + 13));
+
+  // Флаги под маской равны образцу - пакет этого класса
+  struct FlagClass {
+    int32_t mask;
+    int32_t value;
+    FloodKind kind;
+  };
+  static const FlagClass classes[] = {
+      {TH_SYN | TH_ACK, TH_SYN, FLOOD_SYN},
+      {TH_FIN | TH_SYN, TH_FIN, FLOOD_FIN},
+      {TH_SYN | TH_ACK | TH_FIN | TH_RST, 0, FLOOD_NULL},
+      {TH_FIN | TH_URG | TH_PUSH | TH_SYN | TH_ACK, TH_FIN | TH_URG | TH_PUSH,
+       FLOOD_XMAS},
+  };
+  code.push_back(e::movImm(BPF_REG_8, 0));
+  for (const FlagClass &flags : classes) {
+    code.push_back(e::mov(BPF_REG_4, BPF_REG_5));
+    code.push_back(e::aluImm(BPF_AND, BPF_REG_4, flags.mask));
+    code.push_back(e::jumpImm(BPF_JNE, BPF_REG_4, flags.value, 1));
+    code.push_back(e::aluImm(BPF_OR, BPF_REG_8, 1 << flags.kind));
+  }
+  to_pass.push_back(code.size());
+  code.push_back(e::jumpImm(BPF_JEQ, BPF_REG_8, 0, 0));
+
+  // Текущая половина карты
+  const size_t count = code.size();
+  code.push_back(e::storeImm(BPF_W, BPF_REG_10, -4, 0));
+  e::loadMap(code, BPF_REG_1, control);
+  code.push_back(e::mov(BPF_REG_2, BPF_REG_10));
+  code.push_back(e::aluImm(BPF_ADD, BPF_REG_2, -4));
+  code.push_back(e::call(BPF_FUNC_map_lookup_elem));
+  to_pass.push_back(code.size());
+  code.push_back(e::jumpImm(BPF_JEQ, BPF_REG_0, 0, 0));
+  code.push_back(e::load(BPF_W, BPF_REG_1, BPF_REG_0, 0));
+
+  // Ключ {источник, половина}; нет записи - создаём нулевую и ищем снова
+  const int16_t key = -16;
+  const int16_t zero = key - int16_t(sizeof(Counts));
+  code.push_back(e::store(BPF_W, BPF_REG_10, BPF_REG_7, key));
+  code.push_back(e::store(BPF_W, BPF_REG_10, BPF_REG_1, key + 4));
+  e::loadMap(code, BPF_REG_1, counters);
+  code.push_back(e::mov(BPF_REG_2, BPF_REG_10));
+  code.push_back(e::aluImm(BPF_ADD, BPF_REG_2, key));
+  code.push_back(e::call(BPF_FUNC_map_lookup_elem));
+  const size_t found = code.size();
+  code.push_back(e::jumpImm(BPF_JNE, BPF_REG_0, 0, 0));
+  for (int16_t off = 0; off < int16_t(sizeof(Counts)); off += 8) {
+    code.push_back(e::storeImm(BPF_DW, BPF_REG_10, zero + off, 0));
+  }
+  e::loadMap(code, BPF_REG_1, counters);
+  code.push_back(e::mov(BPF_REG_2, BPF_REG_10));
+  code.push_back(e::aluImm(BPF_ADD, BPF_REG_2, key));
+  code.push_back(e::mov(BPF_REG_3, BPF_REG_10));
+  code.push_back(e::aluImm(BPF_ADD, BPF_REG_3, zero));
+  code.push_back(e::movImm(BPF_REG_4, BPF_NOEXIST));
+  code.push_back(e::call(BPF_FUNC_map_update_elem));
+  e::loadMap(code, BPF_REG_1, counters);
+  code.push_back(e::mov(BPF_REG_2, BPF_REG_10));
+  code.push_back(e::aluImm(BPF_ADD, BPF_REG_2, key));
+  code.push_back(e::call(BPF_FUNC_map_lookup_elem));
+  to_pass.push_back(code.size());
+  code.push_back(e::jumpImm(BPF_JEQ, BPF_REG_0, 0, 0));
+
+  // Значение своего CPU: без атомарных операций
+  code[found].off = code.size() - found - 1;
+  for (int kind = 0; kind < FLOOD_KINDS; ++kind) {
+    const int16_t off = offsetof(Counts, packets) + kind * sizeof(uint32_t);
+    code.push_back(e::mov(BPF_REG_1, BPF_REG_8));
+    code.push_back(e::aluImm(BPF_AND, BPF_REG_1, 1 << kind));
+    code.push_back(e::jumpImm(BPF_JEQ, BPF_REG_1, 0, 3));
+    code.push_back(e::load(BPF_W, BPF_REG_1, BPF_REG_0, off));
+    code.push_back(e::aluImm(BPF_ADD, BPF_REG_1, 1));
+    code.push_back(e::store(BPF_W, BPF_REG_0, BPF_REG_1, off));
+  }
+
+  const size_t pass = code.size();
+  code.push_back(e::movImm(BPF_REG_0, XDP_PASS));
+  code.push_back(e::exit());
+  for (size_t at : to_pass) {
+    code[at].off = pass - at - 1;
+  }
+  for (size_t at : to_count) {
+    code[at].off = count - at - 1;
+  }
+  return ebpf::loadProgram(BPF_PROG_TYPE_XDP, BPF_XDP, code, "netf_flood",
+                           log);
+}
+
+bool kernelflood::load() {
+  control = ebpf::createMap(BPF_MAP_TYPE_ARRAY, sizeof(uint32_t),
+                            sizeof(uint32_t), 1, 0, "netf_slot");
+  // Спуфинг вытесняет старые записи LRU, а не отказывает в новых
+  counters = ebpf::createMap(BPF_MAP_TYPE_LRU_PERCPU_HASH, sizeof(Key),
+                             sizeof(Counts), max_entries, 0, "netf_flood");
+  if (control < 0 || counters < 0) {
+    std::cerr << "Kernel flood counters: failed to create maps: "
+              << strerror(errno) << std::endl;
+    detach();
+    return false;
+  }
+  std::string log;
+  program_fd = buildProgram(log);
+  if (program_fd < 0) {
+    std::cerr << "Kernel flood counters: program rejected: "
+              << strerror(errno) << "\n"
+              << log << std::endl;
+    detach();
+    return false;
+  }
+  return true;
+}
+
+bool kernelflood::attach(const std::string &interface, bool native) {
+  const int ifindex = if_nametoindex(interface.c_str());
+  if (ifindex == 0) {
+    std::cerr << "Kernel flood counters: unknown interface " << interface
+              << std::endl;
+    return false;
+  }
+  link = ebpf::attachXdp(program_fd, ifindex,
+                         native ? XDP_FLAGS_DRV_MODE : XDP_FLAGS_SKB_MODE);
+  if (link < 0) {
+    std::cerr << "Kernel flood counters: failed to attach to " << interface
+              << ": " << strerror(errno) << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void kernelflood::detach() {
+  for (int *fd : {&link, &program_fd, &counters, &control}) {
+    if (*fd >= 0) {
+      close(*fd);
+      *fd = -1;
+    }
+  }
+}
+
+// Пакеты, которые программа на другом CPU успела отнести к старой
+// половине после чтения, теряются: их единицы на окно
+bool kernelflood::rotate(std::vector<Totals> &window) {
+  window.clear();
+  const uint32_t zero = 0;
+  const uint32_t old = slot;
+  slot ^= 1;
+  if (!ebpf::update(control, &zero, &slot)) {
+    slot = old;
+    return false;
+  }
+
+  closed.clear();
+  Key key;
+  bool more = ebpf::nextKey(counters, nullptr, &key);
+  while (more) {
+    if (key.slot == old) {
+      closed.push_back(key);
+    }
+    more = ebpf::nextKey(counters, &key, &key);
+  }
+
+  for (const Key &source : closed) {
+    if (ebpf::lookup(counters, &source, per_cpu.data())) {
+      Totals totals = {source.ip, {}};
+      for (const Counts &counts : per_cpu) {
+        for (int kind = 0; kind < FLOOD_KINDS; ++kind) {
+          totals.packets[kind] += counts.packets[kind];
+        }
+      }
+      window.push_back(totals);
+    }
+    ebpf::erase(counters, &source);
+  }
+  return true;
+}
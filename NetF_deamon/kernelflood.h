@@ -0,0 +1,61 @@
+#ifndef KERNELFLOOD_H
+#define KERNELFLOOD_H
+
+#include "detectorset.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Флуд-счётчики в ядре (режим [flood] mode = "kernel"): XDP-программа
+// классифицирует пакет так же, как флуд-детекторы (detectors.h), и
+// считает его в per-CPU карте по адресу источника. Пакеты флуда больше
+// не поднимаются в захват; демон раз в окно забирает суммы по
+// источникам, и пороги проверяются по ним, а не на каждом пакете.
+//
+// Ключ карты - адрес и половина (slot): программа пишет в половину,
+// выбранную в управляющей карте, демон переключает её и читает
+// закрытую, поэтому чтение не гоняется со сбросом.
+class kernelflood {
+public:
+  struct Totals {
+    uint32_t ip; // сетевой порядок
+    uint32_t packets[FLOOD_KINDS];
+  };
+
+  explicit kernelflood(uint32_t max_entries);
+  ~kernelflood();
+
+  bool load();
+  // Своя привязка к интерфейсу; при включённом XDP-блоклисте вместо неё
+  // программа встаёт в его цепочку (xdpblocklist::chain)
+  bool attach(const std::string &interface, bool native);
+  void detach();
+  int program() const { return program_fd; }
+
+  // Закрывает окно: суммы по CPU для каждого источника закрытой
+  // половины; карта после чтения очищается
+  bool rotate(std::vector<Totals> &window);
+
+private:
+  struct Key {
+    uint32_t ip;
+    uint32_t slot;
+  };
+  struct Counts {
+    uint32_t packets[FLOOD_KINDS];
+  };
+
+  int buildProgram(std::string &log);
+
+  uint32_t max_entries;
+  uint32_t cpus;
+  uint32_t slot = 0;
+  int control = -1; // массив из одного u32 - текущая половина
+  int counters = -1;
+  int program_fd = -1;
+  int link = -1;
+  std::vector<Key> closed;
+  std::vector<Counts> per_cpu;
+};
+
+#endif // KERNELFLOOD_H
@@ -0,0 +1,393 @@
+#include "logger.h"
+#include "detectorset.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+struct logger::Ring {
+  static constexpr size_t capacity = 4096; // степень двойки
+
+  alignas(64) std::atomic<uint64_t> head{0}; // пишет производитель
+  alignas(64) std::atomic<uint64_t> tail{0}; // пишет потребитель
+  alignas(64) std::atomic<uint64_t> dropped{0};
+  LogRecord slots[capacity];
+};
+
+std::atomic<LogLevel> logger::threshold{LogLevel::INFO};
+std::atomic<bool> logger::running{false};
+std::mutex logger::rings_mutex;
+std::vector<std::unique_ptr<logger::Ring>> logger::rings;
+std::thread logger::consumer;
+LogConfig logger::config;
+int logger::fd = STDERR_FILENO;
+
+static const char *levelName(LogLevel level) {
+  switch (level) {
+  case LogLevel::TRACE:
+    return "TRACE";
+  case LogLevel::DEBUG:
+    return "DEBUG";
+  case LogLevel::INFO:
+    return "INFO";
+  case LogLevel::WARN:
+    return "WARN";
+  case LogLevel::ERROR:
+    return "ERROR";
+  default:
+    return "OFF";
+  }
+}
+
+// Приоритеты syslog для поля PRIORITY= журнала
+static int syslogPriority(LogLevel level) {
+  switch (level) {
+  case LogLevel::TRACE:
+  case LogLevel::DEBUG:
+    return 7;
+  case LogLevel::INFO:
+    return 6;
+  case LogLevel::WARN:
+    return 4;
+  default:
+    return 3;
+  }
+}
+
+static const char *eventName(LogEvent event) {
+  switch (event) {
+  case LogEvent::PACKET:
+    return "packet";
+  case LogEvent::ETHERNET:
+    return "ethernet";
+  case LogEvent::IPV4:
+    return "ipv4";
+  case LogEvent::TRUNCATED_ETHER:
+  case LogEvent::TRUNCATED_IP:
+  case LogEvent::TRUNCATED_TCP:
+    return "truncated";
+  case LogEvent::PORT_SCAN:
+    return "port_scan";
+  case LogEvent::HOST_SCAN:
+    return "host_scan";
+  case LogEvent::SSH_CONNECT:
+    return "ssh_connect_flood";
+  case LogEvent::SSH_BRUTEFORCE:
+    return "ssh_bruteforce";
+  case LogEvent::FLOOD_VOLUME:
+    return "flood_volume";
+  case LogEvent::TARGET_ATTACK:
+    return "target_attack";
+  case LogEvent::SUBNET_ATTACK:
+    return "subnet_attack";
+  case LogEvent::HALF_OPEN:
+    return "half_open";
+  case LogEvent::XDP_DROPS:
+    return "xdp_drops";
+  case LogEvent::XDP_EXPIRED:
+    return "xdp_expired";
+  }
+  return "unknown";
+}
+
+static std::string ipString(uint64_t ip) {
+  char buf[INET_ADDRSTRLEN];
+  uint32_t addr = ip;
+  inet_ntop(AF_INET, &addr, buf, sizeof(buf));
+  return buf;
+}
+
+static std::string macString(uint64_t mac) {
+  char buf[18];
+  snprintf(buf, sizeof(buf), "%02x:%02x:%02x:%02x:%02x:%02x",
+           unsigned(mac >> 40) & 0xff, unsigned(mac >> 32) & 0xff,
+           unsigned(mac >> 24) & 0xff, unsigned(mac >> 16) & 0xff,
+           unsigned(mac >> 8) & 0xff, unsigned(mac) & 0xff);
+  return buf;
+}
+
+static std::string formatMessage(const LogRecord &r) {
+  char buf[256];
+  const uint64_t *a = r.args;
+  switch (r.event) {
+  case LogEvent::PACKET:
+    snprintf(buf, sizeof(buf),
+             "Packet size: %llu bytes | Captured: %llu bytes | Timestamp: "
+             "%llu.%06llu",
+             (unsigned long long)a[0], (unsigned long long)a[1],
+             (unsigned long long)a[2], (unsigned long long)a[3]);
+    return buf;
+  case LogEvent::ETHERNET:
+    snprintf(buf, sizeof(buf), "Ethernet: Dest: %s  Source: %s  Type: 0x%04x",
+             macString(a[0]).c_str(), macString(a[1]).c_str(),
+             unsigned(a[2]));
+    return buf;
+  case LogEvent::IPV4:
+    snprintf(buf, sizeof(buf),
+             "IP: Version: %u Header len: %u bytes TTL: %u Protocol: %u "
+             "Source: %s Dest: %s",
+             unsigned(a[0]), unsigned(a[1]), unsigned(a[2]), unsigned(a[3]),
+             ipString(a[4]).c_str(), ipString(a[5]).c_str());
+    return buf;
+  case LogEvent::TRUNCATED_ETHER:
+    return "Truncated packet (too small for Ethernet header)";
+  case LogEvent::TRUNCATED_IP:
+    return "Truncated IP packet";
+  case LogEvent::TRUNCATED_TCP:
+    return "Truncated TCP packet";
+  case LogEvent::PORT_SCAN:
+    snprintf(buf, sizeof(buf),
+             "[ALERT] Port Scan detected from: %s (%llu ports in %llu "
+             "seconds)",
+             ipString(a[0]).c_str(), (unsigned long long)a[1],
+             (unsigned long long)a[2]);
+    return buf;
+  case LogEvent::HOST_SCAN:
+    snprintf(buf, sizeof(buf),
+             "[ALERT] Horizontal scan detected from: %s (port %llu on %llu "
+             "hosts in %llu seconds)",
+             ipString(a[0]).c_str(), (unsigned long long)a[1],
+             (unsigned long long)a[2], (unsigned long long)a[3]);
+    return buf;
+  case LogEvent::SSH_CONNECT:
+    snprintf(buf, sizeof(buf),
+             "[ALERT] Possible SSH connection flood from: %s (%llu SYNs in "
+             "%llus)",
+             ipString(a[0]).c_str(), (unsigned long long)a[1],
+             (unsigned long long)a[2]);
+    return buf;
+  case LogEvent::SSH_BRUTEFORCE:
+    snprintf(buf, sizeof(buf),
+             "[ALERT] Possible SSH bruteforce from: %s (%llu auth attempts in "
+             "%llus)",
+             ipString(a[0]).c_str(), (unsigned long long)a[1],
+             (unsigned long long)a[2]);
+    return buf;
+  case LogEvent::FLOOD_VOLUME:
+    snprintf(buf, sizeof(buf),
+             "[ALERT] %s volume: %llu packets in %llu ms, %llu sources above "
+             "threshold",
+             detectorKey(a[0]), (unsigned long long)a[1],
+             (unsigned long long)a[2], (unsigned long long)a[3]);
+    return buf;
+  case LogEvent::TARGET_ATTACK: {
+    std::string port =
+        a[1] == 0 ? "all ports" : "port " + std::to_string(a[1] - 1);
+    snprintf(buf, sizeof(buf),
+             "[ALERT] Target under attack: %s %s (%llu packets in %llu ms "
+             "from %llu sources)",
+             ipString(a[0]).c_str(), port.c_str(), (unsigned long long)a[2],
+             (unsigned long long)a[4], (unsigned long long)a[3]);
+    return buf;
+  }
+  case LogEvent::SUBNET_ATTACK:
+    snprintf(buf, sizeof(buf),
+             "[ALERT] Subnet attack: %s/%llu (%llu blocked addresses), "
+             "blocking the whole prefix",
+             ipString(a[0]).c_str(), (unsigned long long)a[1],
+             (unsigned long long)a[2]);
+    return buf;
+  case LogEvent::HALF_OPEN:
+    snprintf(buf, sizeof(buf),
+             "[ALERT] Half-open flood on %s port %llu: %llu half-open, "
+             "%llu of %llu handshakes completed in %llu ms",
+             ipString(a[0]).c_str(), (unsigned long long)a[1],
+             (unsigned long long)a[2], (unsigned long long)a[4],
+             (unsigned long long)a[3], (unsigned long long)a[5]);
+    return buf;
+  case LogEvent::XDP_DROPS:
+    snprintf(buf, sizeof(buf),
+             "XDP dropped %llu packets from %llu blocked prefixes",
+             (unsigned long long)a[0], (unsigned long long)a[1]);
+    return buf;
+  case LogEvent::XDP_EXPIRED:
+    snprintf(buf, sizeof(buf),
+             "XDP block on %s/%llu expired after %llu dropped packets",
+             ipString(a[0]).c_str(), (unsigned long long)a[1],
+             (unsigned long long)a[2]);
+    return buf;
+  }
+  return "unknown event";
+}
+
+bool logger::parseLevel(const std::string &name, LogLevel &level) {
+  static const std::pair<const char *, LogLevel> names[] = {
+      {"trace", LogLevel::TRACE}, {"debug", LogLevel::DEBUG},
+      {"info", LogLevel::INFO},   {"warn", LogLevel::WARN},
+      {"error", LogLevel::ERROR}, {"off", LogLevel::OFF},
+  };
+  for (const auto &[key, value] : names) {
+    if (name == key) {
+      level = value;
+      return true;
+    }
+  }
+  return false;
+}
+
+void logger::setLevel(LogLevel level) {
+  threshold.store(level, std::memory_order_relaxed);
+}
+
+bool logger::start(const LogConfig &cfg) {
+  LogLevel level;
+  if (!parseLevel(cfg.level, level)) {
+    std::cerr << "Logger: unknown level " << cfg.level << std::endl;
+    return false;
+  }
+
+  config = cfg;
+  if (config.sink == "file") {
+    fd = ::open(config.file.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                0640);
+    if (fd < 0) {
+      std::cerr << "Logger: cannot open " << config.file << ": "
+                << strerror(errno) << std::endl;
+      fd = STDERR_FILENO;
+      return false;
+    }
+  } else if (config.sink == "journald") {
+    fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, "/run/systemd/journal/socket",
+            sizeof(addr.sun_path) - 1);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+      std::cerr << "Logger: journald unavailable, logging to stderr"
+                << std::endl;
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      fd = STDERR_FILENO;
+      config.sink = "stderr";
+    }
+  } else {
+    config.sink = "stderr";
+    fd = STDERR_FILENO;
+  }
+
+  setLevel(level);
+  running.store(true, std::memory_order_release);
+  consumer = std::thread(consume);
+  return true;
+}
+
+void logger::stop() {
+  if (!running.exchange(false)) {
+    return;
+  }
+  consumer.join();
+  drain();
+  if (fd != STDERR_FILENO) {
+    ::close(fd);
+    fd = STDERR_FILENO;
+  }
+}
+
+logger::Ring *logger::localRing() {
+  thread_local Ring *ring = nullptr;
+  if (!ring) {
+    auto fresh = std::make_unique<Ring>();
+    ring = fresh.get();
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    rings.push_back(std::move(fresh));
+  }
+  return ring;
+}
+
+void logger::log(LogLevel level, LogEvent event, uint64_t a0, uint64_t a1,
+                 uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5) {
+  if (!enabled(level) || !running.load(std::memory_order_relaxed)) {
+    return;
+  }
+
+  Ring *ring = localRing();
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  if (head - ring->tail.load(std::memory_order_acquire) == Ring::capacity) {
+    ring->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+
+  LogRecord &record = ring->slots[head & (Ring::capacity - 1)];
+  record.time_us = int64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+  record.event = event;
+  record.level = level;
+  record.args[0] = a0;
+  record.args[1] = a1;
+  record.args[2] = a2;
+  record.args[3] = a3;
+  record.args[4] = a4;
+  record.args[5] = a5;
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+uint64_t logger::dropped() {
+  uint64_t total = 0;
+  std::lock_guard<std::mutex> lock(rings_mutex);
+  for (const auto &ring : rings) {
+    total += ring->dropped.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+bool logger::drain() {
+  bool any = false;
+  std::lock_guard<std::mutex> lock(rings_mutex);
+  for (auto &ring : rings) {
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    for (; tail != head; ++tail) {
+      write(ring->slots[tail & (Ring::capacity - 1)]);
+      any = true;
+    }
+    ring->tail.store(tail, std::memory_order_release);
+  }
+  return any;
+}
+
+void logger::consume() {
+  while (running.load(std::memory_order_acquire)) {
+    if (!drain()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+}
+
+void logger::write(const LogRecord &record) {
+  std::string message = formatMessage(record);
+  std::string out;
+
+  if (config.sink == "journald") {
+    // Нативный протокол journald: поля KEY=value построчно в датаграмме
+    out = "PRIORITY=" + std::to_string(syslogPriority(record.level)) +
+          "\nSYSLOG_IDENTIFIER=netf_deamon\nNETF_EVENT=" +
+          eventName(record.event) + "\nMESSAGE=" + message + "\n";
+    send(fd, out.data(), out.size(), MSG_NOSIGNAL);
+    return;
+  }
+
+  time_t sec = record.time_us / 1000000;
+  struct tm tm;
+  localtime_r(&sec, &tm);
+  char stamp[32];
+  strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &tm);
+
+  char prefix[64];
+  snprintf(prefix, sizeof(prefix), "%s.%06lld %-5s %s: ", stamp,
+           (long long)(record.time_us % 1000000), levelName(record.level),
+           eventName(record.event));
+  out = prefix + message + "\n";
+  if (::write(fd, out.data(), out.size()) < 0) {
+    // писать ошибку логгера больше некуда
+  }
+}
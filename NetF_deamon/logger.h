@@ -0,0 +1,90 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class LogLevel : uint8_t { TRACE, DEBUG, INFO, WARN, ERROR, OFF };
+
+// Типы записей. Текст собирается только в фоновом потоке по этому id и
+// аргументам записи, горячий путь не форматирует строки.
+enum class LogEvent : uint16_t {
+  PACKET,           // len, caplen, ts_sec, ts_usec
+  ETHERNET,         // dst mac, src mac, ethertype
+  IPV4,             // version, header len, ttl, protocol, src, dst
+  TRUNCATED_ETHER,  //
+  TRUNCATED_IP,     //
+  TRUNCATED_TCP,    //
+  PORT_SCAN,        // src, ports, seconds
+  HOST_SCAN,        // src, port, hosts, seconds
+  SSH_CONNECT,      // src, attempts, window seconds
+  SSH_BRUTEFORCE,   // src, attempts, window seconds
+  FLOOD_VOLUME,     // detector, packets, window ms, heavy sources
+  TARGET_ATTACK,    // dst, port + 1 (0 - все порты), rate, sources, window ms
+  SUBNET_ATTACK,    // network, prefix length, blocked members
+  HALF_OPEN,        // dst, port, half-open, started, completed, window ms
+  XDP_DROPS,        // dropped since last refresh, entries
+  XDP_EXPIRED,      // network, prefix length, drops
+};
+
+struct LogConfig {
+  std::string level = "info";
+  std::string sink = "stderr"; // stderr | file | journald
+  std::string file = "/var/log/netf_deamon.log";
+};
+
+// Запись фиксированного размера - одна кэш-линия
+struct LogRecord {
+  int64_t time_us;
+  LogEvent event;
+  LogLevel level;
+  uint8_t reserved[5];
+  uint64_t args[6];
+};
+
+static_assert(sizeof(LogRecord) == 64, "LogRecord must fit a cache line");
+
+// Асинхронный логгер. У каждого пишущего потока своё SPSC-кольцо, запись
+// в него - без блокировок и аллокаций; при переполнении запись теряется
+// и учитывается в dropped(). Фоновый поток форматирует и пишет в sink.
+class logger {
+public:
+  static bool start(const LogConfig &config);
+  static void stop();
+
+  static void setLevel(LogLevel level);
+  static bool parseLevel(const std::string &name, LogLevel &level);
+
+  static bool enabled(LogLevel level) {
+    return level >= threshold.load(std::memory_order_relaxed);
+  }
+
+  static void log(LogLevel level, LogEvent event, uint64_t a0 = 0,
+                  uint64_t a1 = 0, uint64_t a2 = 0, uint64_t a3 = 0,
+                  uint64_t a4 = 0, uint64_t a5 = 0);
+
+  static uint64_t dropped();
+
+private:
+  struct Ring;
+
+  static Ring *localRing();
+  static void consume();
+  static bool drain();
+  static void write(const LogRecord &record);
+
+  static std::atomic<LogLevel> threshold;
+  static std::atomic<bool> running;
+  static std::mutex rings_mutex;
+  static std::vector<std::unique_ptr<Ring>> rings;
+  static std::thread consumer;
+  static LogConfig config;
+  static int fd;
+};
+
+#endif // LOGGER_H
@@ -1,21 +1,65 @@
+#include "config.h"
 #include "firewall.h"
+#include "incidenttable.h"
+#include "logger.h"
+#include "nftmitigator.h"
 #include "trafficmonitor.h"
+#include "xdpblocklist.h"
+#include <algorithm>
+#include <arpa/inet.h>
 #include <csignal>
+#include <cstdlib>
 #include <dbus-1.0/dbus/dbus.h>
+#include <getopt.h>
+#include <chrono>
 #include <iostream>
+#include <poll.h>
 #include <pwd.h>
 #include <thread>
 #include <unistd.h>
 
+// Куда уходят блокировки; любой из механизмов может быть выключен
+struct Mitigation {
+  std::unique_ptr<nftmitigator> nft;
+  std::unique_ptr<xdpblocklist> xdp;
+  uint32_t ttl = 0;       // секунд, как у пула блокировки
+  uint8_t min_prefix = 8; // самый короткий префикс ручного Ban
+};
+
 volatile sig_atomic_t stop_flag = 0;
+volatile sig_atomic_t reload_flag = 0;
 DBusConnection *dbus_conn = nullptr;
 
-void signal_handler(int signum) {
-  stop_flag = 1;
-  if (dbus_conn) {
-    dbus_connection_unref(dbus_conn);
-    dbus_conn = nullptr;
+// Только флаг: libdbus не async-signal-safe, а соединение ещё нужно
+// закрытиям инцидентов - его отпускает main после последнего flush
+void signal_handler(int /*signum*/) { stop_flag = 1; }
+
+void reload_handler(int /*signum*/) { reload_flag = 1; }
+
+void reload_config(const std::string &path, trafficmonitor &monitor) {
+  DaemonConfig fresh;
+  bool loaded = false;
+  try {
+    loaded = !path.empty() && config::load(path, fresh);
+  } catch (const std::exception &e) {
+    std::cerr << "Config error: " << e.what() << std::endl;
+  }
+  if (!loaded) {
+    std::cerr << "Config reload failed, keeping current settings"
+              << std::endl;
+    return;
   }
+  // Правила компилируются целиком до подмены: воркеры видят либо
+  // старую таблицу, либо новую, захват не прерывается
+  monitor.setRules(fresh.rules);
+  LogLevel level;
+  if (logger::parseLevel(fresh.logging.level, level)) {
+    logger::setLevel(level);
+  }
+  std::cout << "Config reloaded from " << path << " ("
+            << fresh.rules->overrideCount() << " subnet overrides, "
+            << fresh.rules->listedPrefixes() << " listed prefixes)"
+            << std::endl;
 }
 
 bool init_dbus_connection() {
@@ -71,51 +115,519 @@ void send_dbus_attack_signal(const std::string &attack_type,
     std::cerr << "Failed to send message" << std::endl;
   }
 
-  dbus_connection_flush(dbus_conn);
   dbus_message_unref(msg);
 }
 
-void process_detected_attacks() {
-  auto attacks = firewall::getDetectedAttacks();
-  for (const auto &attack : attacks) {
-    std::cout << "Sending attack alert: " << attack.type << " from "
-              << attack.source_ip << std::endl;
-    send_dbus_attack_signal(attack.type, attack.source_ip, attack.count);
+// AttacksDetected(a(uuiqt)): открытия и обновления инцидентов пачкой -
+// тип AttackType, IPv4 в порядке хоста, счётчик, длина префикса, время
+// алерта. Строки и разбор адреса остаются на стороне GUI.
+const size_t kAttacksPerSignal = 1024;
+
+void send_dbus_attacks_signal(
+    const std::vector<const incidenttable::Incident *> &batch) {
+  for (size_t first = 0; first < batch.size(); first += kAttacksPerSignal) {
+    DBusMessage *msg = dbus_message_new_signal(
+        "/com/netf/daemon", "com.netf.daemon", "AttacksDetected");
+    if (!msg) {
+      std::cerr << "Failed to create D-Bus message" << std::endl;
+      return;
+    }
+    const size_t last = std::min(batch.size(), first + kAttacksPerSignal);
+    DBusMessageIter args, array;
+    dbus_message_iter_init_append(msg, &args);
+    bool ok = dbus_message_iter_open_container(&args, DBUS_TYPE_ARRAY,
+                                               "(uuiqt)", &array);
+    for (size_t i = first; ok && i < last; ++i) {
+      const incidenttable::Incident &incident = *batch[i];
+      dbus_uint32_t type = incident.type;
+      dbus_uint32_t ip = ntohl(incident.ip);
+      dbus_int32_t count = incident.count;
+      dbus_uint16_t length = incident.length;
+      dbus_uint64_t timestamp = incident.last_seen;
+      DBusMessageIter entry;
+      ok = dbus_message_iter_open_container(&array, DBUS_TYPE_STRUCT,
+                                            nullptr, &entry) &&
+           dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT32, &type) &&
+           dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT32, &ip) &&
+           dbus_message_iter_append_basic(&entry, DBUS_TYPE_INT32, &count) &&
+           dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT16,
+                                          &length) &&
+           dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64,
+                                          &timestamp) &&
+           dbus_message_iter_close_container(&array, &entry);
+    }
+    ok = ok && dbus_message_iter_close_container(&args, &array);
+    // Без flush: сообщение уходит из главного цикла, когда сокет готов
+    if (!ok || !dbus_connection_send(dbus_conn, msg, nullptr)) {
+      std::cerr << "Failed to send message" << std::endl;
+    }
+    dbus_message_unref(msg);
+  }
+}
+
+// IncidentClosed(s type, s address, u alerts, u seconds, u peak)
+void send_dbus_incident_closed(const incidenttable::Incident &incident) {
+  DBusMessage *msg = dbus_message_new_signal(
+      "/com/netf/daemon", "com.netf.daemon", "IncidentClosed");
+  if (!msg) {
+    std::cerr << "Failed to create D-Bus message" << std::endl;
+    return;
+  }
+  const char *type = attackName(incident.type);
+  const char *address = incident.address.c_str();
+  dbus_uint32_t alerts = incident.alerts;
+  dbus_uint32_t seconds = incident.last_seen - incident.opened;
+  dbus_uint32_t peak = incident.peak;
+  if (!dbus_message_append_args(msg, DBUS_TYPE_STRING, &type,
+                                DBUS_TYPE_STRING, &address, DBUS_TYPE_UINT32,
+                                &alerts, DBUS_TYPE_UINT32, &seconds,
+                                DBUS_TYPE_UINT32, &peak, DBUS_TYPE_INVALID) ||
+      !dbus_connection_send(dbus_conn, msg, nullptr)) {
+    std::cerr << "Failed to send message" << std::endl;
+  }
+  dbus_message_unref(msg);
+}
+
+// Открытие и обновления инцидента уходят пачкой AttacksDetected и, для
+// старых подписчиков, прежним AttackDetected по одному
+void publish_incidents(const std::vector<incidenttable::Event> &events) {
+  std::vector<const incidenttable::Incident *> batch;
+  for (const auto &event : events) {
+    const incidenttable::Incident &incident = event.incident;
+    const char *type = attackName(incident.type);
+    switch (event.phase) {
+    case incidenttable::Phase::OPEN:
+      std::cout << "Attack started: " << type << " from " << incident.address
+                << " (" << incident.count << ")" << std::endl;
+      break;
+    case incidenttable::Phase::UPDATE:
+      std::cout << "Attack ongoing: " << type << " from " << incident.address
+                << ", " << incident.alerts << " alerts, peak "
+                << incident.peak << std::endl;
+      break;
+    case incidenttable::Phase::CLOSE:
+      std::cout << "Attack ended: " << type << " from " << incident.address
+                << " after " << incident.last_seen - incident.opened
+                << " s, " << incident.alerts << " alerts, peak "
+                << incident.peak << std::endl;
+      break;
+    }
+    if (!dbus_conn) {
+      continue;
+    }
+    if (event.phase == incidenttable::Phase::CLOSE) {
+      send_dbus_incident_closed(incident);
+    } else {
+      send_dbus_attack_signal(type, incident.address, incident.count);
+      batch.push_back(&incident);
+    }
+  }
+  if (!batch.empty()) {
+    send_dbus_attacks_signal(batch);
+  }
+}
+
+// Stats() -> (tttttt): занятость таблиц источников, сканов, адресов
+// назначения и потоков, вытеснения и отказы в допуске по всем воркерам
+DBusMessage *stats_reply(DBusMessage *call, trafficmonitor &monitor) {
+  DBusMessage *reply = dbus_message_new_method_return(call);
+  if (!reply) {
+    return nullptr;
+  }
+  dbus_uint64_t sources = monitor.sum(&firewall::Counters::sources_used);
+  dbus_uint64_t scans = monitor.sum(&firewall::Counters::scans_used);
+  dbus_uint64_t targets = monitor.sum(&firewall::Counters::targets_used);
+  dbus_uint64_t flows = monitor.sum(&firewall::Counters::flows_used);
+  dbus_uint64_t evictions = monitor.sum(&firewall::Counters::evictions);
+  dbus_uint64_t rejected = monitor.untrackedPackets() +
+                           monitor.untrackedTargets() +
+                           monitor.untrackedFlows();
+  dbus_message_append_args(reply, DBUS_TYPE_UINT64, &sources,
+                           DBUS_TYPE_UINT64, &scans, DBUS_TYPE_UINT64,
+                           &targets, DBUS_TYPE_UINT64, &flows,
+                           DBUS_TYPE_UINT64, &evictions, DBUS_TYPE_UINT64,
+                           &rejected, DBUS_TYPE_INVALID);
+  return reply;
+}
+
+// Ban(s ip): ручная блокировка из GUI тем же путём, что и автоматическая;
+// адрес или префикс, как в строках свёрнутых подсетей. Вызвать метод
+// может любой клиент сессионной шины, поэтому префикс короче
+// min_prefix (и 0.0.0.0/0, отрезающий весь IPv4) отклоняется.
+DBusMessage *ban_reply(DBusMessage *call, Mitigation &mitigation) {
+  const char *text = nullptr;
+  SubnetRule subnet;
+  if (!dbus_message_get_args(call, nullptr, DBUS_TYPE_STRING, &text,
+                             DBUS_TYPE_INVALID) ||
+      !ruletable::parseSubnet(text, subnet)) {
+    return dbus_message_new_error(call, DBUS_ERROR_INVALID_ARGS,
+                                  "Expected an IPv4 address or prefix");
+  }
+  if (subnet.prefix < mitigation.min_prefix) {
+    const std::string error = "Prefix shorter than /" +
+                              std::to_string(mitigation.min_prefix) +
+                              " is not allowed";
+    return dbus_message_new_error(call, DBUS_ERROR_INVALID_ARGS,
+                                  error.c_str());
+  }
+  if (!mitigation.nft && !mitigation.xdp) {
+    return dbus_message_new_error(call, DBUS_ERROR_NOT_SUPPORTED,
+                                  "Mitigation is disabled");
+  }
+  if (mitigation.nft) {
+    mitigation.nft->ban(subnet.network, subnet.prefix);
+  }
+  if (mitigation.xdp) {
+    mitigation.xdp->block(subnet.network, subnet.prefix, mitigation.ttl);
+  }
+  std::cout << "Manual ban: " << text << std::endl;
+  return dbus_message_new_method_return(call);
+}
+
+// XdpDrops() -> a(st): префиксы в XDP-карте и отброшенные пакеты по
+// последнему refresh
+DBusMessage *xdp_drops_reply(DBusMessage *call, Mitigation &mitigation) {
+  if (!mitigation.xdp) {
+    return dbus_message_new_error(call, DBUS_ERROR_NOT_SUPPORTED,
+                                  "XDP blocklist is disabled");
+  }
+  DBusMessage *reply = dbus_message_new_method_return(call);
+  if (!reply) {
+    return nullptr;
+  }
+  DBusMessageIter args, array;
+  dbus_message_iter_init_append(reply, &args);
+  dbus_message_iter_open_container(&args, DBUS_TYPE_ARRAY, "(st)", &array);
+  mitigation.xdp->forEach([&](uint32_t network, uint8_t length,
+                              uint64_t drops) {
+    char address[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &network, address, sizeof(address));
+    std::string prefix =
+        std::string(address) + "/" + std::to_string(length);
+    const char *text = prefix.c_str();
+    dbus_uint64_t count = drops;
+    DBusMessageIter entry;
+    dbus_message_iter_open_container(&array, DBUS_TYPE_STRUCT, nullptr,
+                                     &entry);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_STRING, &text);
+    dbus_message_iter_append_basic(&entry, DBUS_TYPE_UINT64, &count);
+    dbus_message_iter_close_container(&array, &entry);
+  });
+  dbus_message_iter_close_container(&args, &array);
+  return reply;
+}
+
+// Входящие вызовы com.netf.daemon: Reload() перечитывает конфиг так же,
+// как SIGHUP. Обрабатываются в главном цикле без блокировки.
+void process_dbus_requests(trafficmonitor &monitor, Mitigation &mitigation) {
+  if (!dbus_conn || !dbus_connection_read_write(dbus_conn, 0)) {
+    return;
+  }
+
+  while (DBusMessage *msg = dbus_connection_pop_message(dbus_conn)) {
+    if (dbus_message_get_type(msg) == DBUS_MESSAGE_TYPE_METHOD_CALL) {
+      DBusMessage *reply;
+      if (dbus_message_is_method_call(msg, "com.netf.daemon", "Reload")) {
+        reload_flag = 1;
+        reply = dbus_message_new_method_return(msg);
+      } else if (dbus_message_is_method_call(msg, "com.netf.daemon",
+                                             "Stats")) {
+        reply = stats_reply(msg, monitor);
+      } else if (dbus_message_is_method_call(msg, "com.netf.daemon", "Ban")) {
+        reply = ban_reply(msg, mitigation);
+      } else if (dbus_message_is_method_call(msg, "com.netf.daemon",
+                                             "XdpDrops")) {
+        reply = xdp_drops_reply(msg, mitigation);
+      } else {
+        reply = dbus_message_new_error(msg, DBUS_ERROR_UNKNOWN_METHOD,
+                                       "Unknown method");
+      }
+      if (reply) {
+        dbus_connection_send(dbus_conn, reply, nullptr);
+        dbus_message_unref(reply);
+      }
+    }
+    dbus_message_unref(msg);
+  }
+}
+
+void process_detected_attacks(trafficmonitor &monitor,
+                              incidenttable &incidents,
+                              Mitigation &mitigation) {
+  std::vector<incidenttable::Event> events;
+  for (const auto &attack : monitor.collectAttacks()) {
+    incidents.observe(attack, events);
   }
-  firewall::clearDetectedAttacks();
+  publish_incidents(events);
+  // Адрес уходит в ядро, когда попадает в пул, и снова, когда его
+  // запись там прожила половину срока. Захват видит пакеты раньше
+  // netfilter: атакующий, отброшенный nftables, продолжает поднимать
+  // алерты, и повторный ban перезапускает timeout. Отброшенное XDP до
+  // захвата не доходит - такой адрес вернётся новым алертом, когда
+  // запись истечёт.
+  for (const auto &source : monitor.takeBlockedSources()) {
+    if (mitigation.nft) {
+      mitigation.nft->ban(source.ip, source.length);
+    }
+    if (mitigation.xdp) {
+      mitigation.xdp->block(source.ip, source.length, mitigation.ttl);
+    }
+  }
+}
+
+void print_usage(const char *prog) {
+  std::cerr << "Usage: " << prog
+            << " [config] [-r capture.pcap [-s speed]]\n"
+               "  -r, --replay FILE  analyze a recorded capture instead of "
+               "the live interface\n"
+               "  -s, --speed X      replay paced by capture timestamps, X "
+               "times faster;\n"
+               "                     0 (default) replays as fast as possible"
+            << std::endl;
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+  static const struct option long_options[] = {
+      {"replay", required_argument, nullptr, 'r'},
+      {"speed", required_argument, nullptr, 's'},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0},
+  };
+
+  std::string replay_file;
+  double replay_speed = 0;
+  int opt;
+  while ((opt = getopt_long(argc, argv, "r:s:h", long_options, nullptr)) !=
+         -1) {
+    switch (opt) {
+    case 'r':
+      replay_file = optarg;
+      break;
+    case 's':
+      replay_speed = atof(optarg);
+      break;
+    default:
+      print_usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+
+  DaemonConfig daemon_config;
+  std::string config_path;
+  if (optind < argc) {
+    config_path = argv[optind];
+    if (!config::load(config_path, daemon_config)) {
+      return 1;
+    }
+  } else if (access("/etc/netf/netf.conf", R_OK) == 0) {
+    config_path = "/etc/netf/netf.conf";
+    config::load(config_path, daemon_config);
+  }
+
+  const bool replay = !replay_file.empty();
+  daemon_config.capture.replay_file = replay_file;
+  daemon_config.capture.replay_speed = replay_speed;
+
   signal(SIGINT, signal_handler);
   signal(SIGTERM, signal_handler);
+  signal(SIGHUP, reload_handler);
 
-  if (system("sudo setcap cap_net_raw,cap_net_admin+eip $(realpath "
-             "./NetF_deamon)") != 0) {
+  if (!replay && system("sudo setcap cap_net_raw,cap_net_admin+eip $(realpath "
+                        "./NetF_deamon)") != 0) {
     std::cerr << "Warning: Failed to set capabilities" << std::endl;
   }
 
+  // Офлайн-прогон полезен и без сессионной шины: алерты всё равно
+  // печатаются, D-Bus просто пропускается
   if (!init_dbus_connection()) {
     std::cerr << "Failed to initialize D-Bus connection" << std::endl;
+    if (!replay) {
+      return 1;
+    }
+  }
+
+  if (!logger::start(daemon_config.logging)) {
     return 1;
   }
 
-  std::thread monitor_thread([]() {
-    try {
-      trafficmonitor::monitorTraffic("lo");
-    } catch (const std::exception &e) {
-      std::cerr << "Monitor error: " << e.what() << std::endl;
-      stop_flag = 1;
+  // Офлайн-прогон ничего не блокирует
+  Mitigation mitigation;
+  mitigation.ttl = daemon_config.detection.block_ttl;
+  mitigation.min_prefix = daemon_config.mitigation.min_prefix;
+  if (daemon_config.mitigation.enabled && !replay) {
+    mitigation.nft = std::make_unique<nftmitigator>(daemon_config.mitigation);
+    if (!mitigation.nft->start()) {
+      std::cerr << "nftables mitigation disabled" << std::endl;
+      mitigation.nft.reset();
     }
-  });
+  }
+  if (daemon_config.xdp.enabled && !replay) {
+    mitigation.xdp = std::make_unique<xdpblocklist>(daemon_config.xdp);
+    if (mitigation.xdp->attach(daemon_config.capture.interface)) {
+      std::cout << "XDP blocklist attached to "
+                << daemon_config.capture.interface << " ("
+                << daemon_config.xdp.mode << " mode)" << std::endl;
+    } else {
+      std::cerr << "XDP blocklist disabled" << std::endl;
+      mitigation.xdp.reset();
+    }
+  }
+
+  // XDP-программа на интерфейсе одна: при блоклисте счётчики флуда
+  // встают в его цепочку
+  std::unique_ptr<kernelflood> kernel_counters;
+  if (daemon_config.detection.flood_mode == "kernel") {
+    kernel_counters =
+        std::make_unique<kernelflood>(daemon_config.detection.kernel_entries);
+    const bool ready =
+        !replay && kernel_counters->load() &&
+        (mitigation.xdp
+             ? mitigation.xdp->chain(kernel_counters->program())
+             : kernel_counters->attach(daemon_config.capture.interface,
+                                       daemon_config.xdp.mode == "native"));
+    if (!ready) {
+      std::cerr << "Kernel flood counters unavailable, using exact mode"
+                << std::endl;
+      daemon_config.detection.flood_mode = "exact";
+      kernel_counters.reset();
+    }
+  }
 
+  std::unique_ptr<trafficmonitor> monitor_holder;
+  try {
+    monitor_holder = std::make_unique<trafficmonitor>(
+        daemon_config.capture, daemon_config.detection,
+        daemon_config.aggregate);
+  } catch (const std::exception &e) {
+    std::cerr << "Monitor error: " << e.what() << std::endl;
+    logger::stop();
+    if (dbus_conn) {
+      dbus_connection_unref(dbus_conn);
+    }
+    return 1; // блокировщики снимаются деструкторами Mitigation
+  }
+  trafficmonitor &monitor = *monitor_holder;
+  monitor.setKernelCounters(std::move(kernel_counters));
+  monitor.setRules(daemon_config.rules);
+  try {
+    monitor.start(stop_flag);
+  } catch (const std::exception &e) {
+    std::cerr << "Monitor error: " << e.what() << std::endl;
+    stop_flag = 1;
+  }
+
+  // Цикл спит в poll: алерт будит его через eventfd очереди, вызов
+  // D-Bus - через сокет шины. Исходящие сигналы не сбрасываются
+  // блокирующим flush: пока очередь libdbus не пуста, цикл ждёт и
+  // POLLOUT, а дописывает read_write с нулевым таймаутом. Таймаут poll
+  // нужен только флагам сигналов и периодическим делам.
+  alertqueue &alerts = monitor.alerts();
+  int bus_fd = -1;
+  if (dbus_conn) {
+    dbus_connection_get_unix_fd(dbus_conn, &bus_fd);
+  }
+  incidenttable incidents(daemon_config.incidents);
+  std::vector<incidenttable::Event> events;
+  auto next_refresh = std::chrono::steady_clock::now();
   while (!stop_flag) {
-    process_detected_attacks();
-    usleep(100000); // 100ms
+    process_dbus_requests(monitor, mitigation);
+    if (reload_flag) {
+      reload_flag = 0;
+      reload_config(config_path, monitor);
+    }
+    process_detected_attacks(monitor, incidents, mitigation);
+    const auto now = std::chrono::steady_clock::now();
+    if (now >= next_refresh) {
+      if (mitigation.xdp) {
+        mitigation.xdp->refresh();
+      }
+      // В replay инциденты закрываются по времени файла
+      events.clear();
+      incidents.expire(replay ? 0 : time(nullptr), events);
+      publish_incidents(events);
+      next_refresh = now + std::chrono::seconds(1);
+    }
+    if (alerts.prepareWait()) {
+      short bus_events = POLLIN;
+      if (dbus_conn && dbus_connection_has_messages_to_send(dbus_conn)) {
+        bus_events |= POLLOUT;
+      }
+      struct pollfd fds[] = {{alerts.fd(), POLLIN, 0},
+                             {bus_fd, bus_events, 0}};
+      poll(fds, 2, 100);
+      alerts.acknowledge();
+    }
   }
 
-  monitor_thread.join();
+  monitor.join();
+  process_detected_attacks(monitor, incidents, mitigation);
+  events.clear();
+  incidents.closeAll(events);
+  publish_incidents(events);
+  if (incidents.merged() > 0 || incidents.rejected() > 0) {
+    std::cout << "Incidents: " << incidents.merged()
+              << " repeated alerts merged, " << incidents.rejected()
+              << " dropped with the table full" << std::endl;
+  }
+  if (mitigation.nft) {
+    mitigation.nft->stop();
+    std::cout << "nftables: " << mitigation.nft->banned()
+              << " addresses banned in " << mitigation.nft->commits()
+              << " commits, " << mitigation.nft->failures() << " failed"
+              << std::endl;
+  }
+  if (mitigation.xdp) {
+    mitigation.xdp->refresh();
+    std::cout << "XDP: " << mitigation.xdp->drops()
+              << " packets dropped from blocked sources" << std::endl;
+    mitigation.xdp->detach();
+  }
+
+  CaptureStats stats = monitor.captureStats();
+  std::cout << "Capture stopped: " << stats.packets << " packets, "
+            << stats.drops << " dropped, " << monitor.totalPackets()
+            << " analyzed by " << monitor.workerCount() << " worker(s), "
+            << monitor.allowedPackets() << " allowed and "
+            << monitor.deniedPackets() << " denied by lists" << std::endl;
+  if (monitor.droppedAlerts() > 0) {
+    std::cerr << "Alert queue full, " << monitor.droppedAlerts()
+              << " alerts dropped (raise [limits] alert_queue)" << std::endl;
+  }
+  if (monitor.untrackedPackets() > 0) {
+    std::cerr << "Source table full, " << monitor.untrackedPackets()
+              << " packets not tracked (raise [limits] max_sources)"
+              << std::endl;
+  }
+  if (monitor.untrackedTargets() > 0) {
+    std::cerr << "Target table full, " << monitor.untrackedTargets()
+              << " packets not tracked (raise [limits] max_targets)"
+              << std::endl;
+  }
+  if (monitor.sum(&firewall::Counters::evictions) > 0) {
+    std::cout << "Evicted " << monitor.sum(&firewall::Counters::evictions)
+              << " detector records to stay within table limits"
+              << std::endl;
+  }
+  if (monitor.sum(&firewall::Counters::blocks_dropped) > 0) {
+    std::cerr << "Block queue full, "
+              << monitor.sum(&firewall::Counters::blocks_dropped)
+              << " new blocks not mitigated (raise [limits] max_blocked)"
+              << std::endl;
+  }
+  if (monitor.untrackedFlows() > 0) {
+    std::cerr << "Flow table full, " << monitor.untrackedFlows()
+              << " handshakes not tracked (raise [limits] max_flows)"
+              << std::endl;
+  }
+
+  logger::stop();
+  if (logger::dropped() > 0) {
+    std::cerr << "Logger dropped " << logger::dropped() << " records"
+              << std::endl;
+  }
 
   if (dbus_conn) {
+    dbus_connection_flush(dbus_conn); // закрытия инцидентов
     dbus_connection_unref(dbus_conn);
   }
 
@@ -0,0 +1,266 @@
+#include "nftmitigator.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cctype>
+#include <chrono>
+#include <iostream>
+#ifdef NETF_HAVE_NFTABLES
+#include <nftables/libnftables.h>
+#endif
+
+bool MitigationConfig::validName(const std::string &name) {
+  return !name.empty() && name.size() < 64 &&
+         std::all_of(name.begin(), name.end(), [](char c) {
+           return isalnum(static_cast<unsigned char>(c)) || c == '_';
+         });
+}
+
+nftmitigator::nftmitigator(const MitigationConfig &config)
+    : config(config) {}
+
+nftmitigator::~nftmitigator() { stop(); }
+
+bool nftmitigator::execute(const std::string &commands) {
+#ifdef NETF_HAVE_NFTABLES
+  if (nft_run_cmd_from_buffer(ctx, commands.c_str()) != 0) {
+    std::cerr << "nftables: " << nft_ctx_get_error_buffer(ctx);
+    return false;
+  }
+  return true;
+#else
+  (void)commands;
+  return false;
+#endif
+}
+
+bool nftmitigator::start() {
+#ifdef NETF_HAVE_NFTABLES
+  ctx = nft_ctx_new(NFT_CTX_DEFAULT);
+  if (!ctx) {
+    std::cerr << "nftables: failed to create context" << std::endl;
+    return false;
+  }
+  nft_ctx_buffer_output(ctx);
+  nft_ctx_buffer_error(ctx);
+
+  // Таблица пересоздаётся с нуля: после аварийного выхода в ней могли
+  // остаться старые правила. Всё - одной транзакцией.
+  const std::string table = "ip " + config.table;
+  const std::string timeout =
+      "timeout " + std::to_string(config.timeout) + "s; }\n";
+  std::string setup =
+      "add table " + table + "\n" + "delete table " + table + "\n" +
+      "add table " + table + "\n" + "add set " + table + " " + config.set +
+      " { type ipv4_addr; flags timeout; " + timeout + "add set " + table +
+      " " + config.set + "_net { type ipv4_addr; flags interval, timeout; " +
+      timeout;
+  if (config.drop) {
+    // Приоритет raw: отброшенный пакет не доходит до conntrack
+    setup += "add chain " + table +
+             " prerouting { type filter hook prerouting priority -300; "
+             "policy accept; }\n" +
+             "add rule " + table + " prerouting ip saddr @" + config.set +
+             " counter drop\n" + "add rule " + table +
+             " prerouting ip saddr @" + config.set + "_net counter drop\n";
+  }
+  if (!execute(setup)) {
+    nft_ctx_free(ctx);
+    ctx = nullptr;
+    return false;
+  }
+  stopping = false;
+  thread = std::thread(&nftmitigator::run, this);
+  return true;
+#else
+  std::cerr << "nftables: daemon built without libnftables" << std::endl;
+  return false;
+#endif
+}
+
+void nftmitigator::stop() {
+  if (!thread.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wakeup.notify_one();
+  thread.join();
+#ifdef NETF_HAVE_NFTABLES
+  if (!config.keep_on_exit) {
+    execute("delete table ip " + config.table + "\n");
+  }
+  nft_ctx_free(ctx);
+  ctx = nullptr;
+#endif
+}
+
+void nftmitigator::ban(uint32_t network, uint8_t length) {
+  bool wake;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.emplace_back(network, length);
+    wake = pending.size() == 1 || pending.size() >= config.batch;
+  }
+  if (wake) {
+    wakeup.notify_one();
+  }
+}
+
+void nftmitigator::run() {
+  std::vector<Prefix> batch;
+  std::unique_lock<std::mutex> lock(mutex);
+  for (;;) {
+    wakeup.wait(lock, [&] { return stopping || !pending.empty(); });
+    if (pending.empty()) {
+      return;
+    }
+    // Первый адрес ждёт попутчиков не дольше flush_ms: при флуде пачка
+    // набирается раньше, в тишине блокировка уходит почти сразу
+    wakeup.wait_for(lock, std::chrono::milliseconds(config.flush_ms), [&] {
+      return stopping || pending.size() >= config.batch;
+    });
+    batch.swap(pending);
+    lock.unlock();
+    commit(batch);
+    batch.clear();
+    lock.lock();
+  }
+}
+
+// Забытые записи: ядро уже удалило эти элементы само
+void nftmitigator::prune(Clock::time_point now) {
+  if (now < next_prune) {
+    return;
+  }
+  next_prune = now + std::chrono::seconds(1);
+  std::erase_if(live_addresses,
+                [&](const auto &entry) { return entry.second <= now; });
+  std::erase_if(live_prefixes,
+                [&](const auto &entry) { return entry.second <= now; });
+}
+
+std::string nftmitigator::elements(const char *verb, const std::string &set,
+                                   const std::vector<Prefix> &list) const {
+  std::string command = std::string(verb) + " element ip " + config.table +
+                        " " + set + " { ";
+  command.reserve(command.size() + list.size() * 20);
+  for (size_t i = 0; i < list.size(); ++i) {
+    char address[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &list[i].first, address, sizeof(address));
+    if (i != 0) {
+      command += ", ";
+    }
+    command += address;
+    if (list[i].second != 32) {
+      command += "/" + std::to_string(list[i].second);
+    }
+  }
+  return command + " }\n";
+}
+
+// Элемент мог исчезнуть раньше срока (nft flush руками), и тогда delete
+// валит всю транзакцию: снимаем по одному то, что осталось, и
+// добавляем заново
+bool nftmitigator::replace(const std::string &set,
+                           const std::vector<Prefix> &removed,
+                           const std::vector<Prefix> &added) {
+  commit_count++;
+  const std::string add = elements("add", set, added);
+  if (execute(removed.empty() ? add
+                              : elements("delete", set, removed) + add)) {
+    return true;
+  }
+  if (!removed.empty()) {
+    for (const Prefix &prefix : removed) {
+      execute(elements("delete", set, {prefix}));
+    }
+    commit_count++;
+    if (execute(add)) {
+      return true;
+    }
+  }
+  failure_count++;
+  return false;
+}
+
+// Повторы внутри пачки убираются заранее. Адреса уходят пачками: новые
+// одной командой add, уже стоящие - delete + add, чтобы ядро начало их
+// timeout заново. Префиксы - в свой набор по одной транзакции.
+void nftmitigator::commit(std::vector<Prefix> &batch) {
+  const Clock::time_point now = Clock::now();
+  // Срок считается от начала коммита: ядро ставит элемент позже, так
+  // что живая здесь запись жива и там
+  const Clock::time_point expires = now + std::chrono::seconds(config.timeout);
+  prune(now);
+
+  std::sort(batch.begin(), batch.end());
+  batch.erase(std::unique(batch.begin(), batch.end()), batch.end());
+  std::vector<Prefix> fresh, known;
+  for (const Prefix &prefix : batch) {
+    if (prefix.second != 32) {
+      continue;
+    }
+    const auto it = live_addresses.find(prefix.first);
+    (it != live_addresses.end() && it->second > now ? known : fresh)
+        .push_back(prefix);
+  }
+
+  auto apply = [&](std::vector<Prefix> &list, bool refresh) {
+    std::vector<Prefix> chunk;
+    for (size_t begin = 0; begin < list.size(); begin += config.batch) {
+      const size_t end = std::min<size_t>(list.size(), begin + config.batch);
+      chunk.assign(list.begin() + begin, list.begin() + end);
+      if (!replace(config.set, refresh ? chunk : std::vector<Prefix>(),
+                   chunk)) {
+        continue;
+      }
+      if (!refresh) {
+        banned_count += chunk.size();
+      }
+      for (const Prefix &prefix : chunk) {
+        live_addresses[prefix.first] = expires;
+      }
+    }
+  };
+  apply(fresh, false);
+  apply(known, true);
+
+  // Интервалы в наборе не пересекаются: префикс, накрывший стоящие
+  // (свёртка /24 в /16), снимает их в той же транзакции, а префикс под
+  // живым покрывающим уже отброшен им
+  const std::string net = config.set + "_net";
+  for (const Prefix &prefix : batch) {
+    if (prefix.second == 32) {
+      continue;
+    }
+    const uint32_t mask = htonl(prefix.second ? ~0u << (32 - prefix.second)
+                                              : 0);
+    bool covered = false, refresh = false;
+    std::vector<Prefix> removed;
+    for (const auto &[live, until] : live_prefixes) {
+      if (until <= now) {
+        continue;
+      }
+      if (live.second < prefix.second) {
+        const uint32_t outer =
+            htonl(live.second ? ~0u << (32 - live.second) : 0);
+        covered |= (prefix.first & outer) == live.first;
+      } else if ((live.first & mask) == prefix.first) {
+        refresh |= live == prefix;
+        removed.push_back(live);
+      }
+    }
+    if (covered) {
+      continue;
+    }
+    if (replace(net, removed, {prefix})) {
+      banned_count += !refresh;
+      for (const Prefix &inner : removed) {
+        live_prefixes.erase(inner);
+      }
+      live_prefixes[prefix] = expires;
+    }
+  }
+}
@@ -0,0 +1,97 @@
+#ifndef NFTMITIGATOR_H
+#define NFTMITIGATOR_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct nft_ctx;
+
+struct MitigationConfig {
+  bool enabled = false;
+  std::string table = "netf"; // таблица семейства ip
+  std::string set = "blocked";
+  uint32_t timeout = 0;     // секунд; 0 - как [limits] block_ttl
+  uint32_t batch = 4096;    // адресов в одной транзакции
+  uint32_t flush_ms = 50;   // сколько первый адрес ждёт остальных
+  bool drop = true;         // false - только набор, правила свои
+  bool keep_on_exit = false; // не удалять таблицу при остановке
+  uint32_t min_prefix = 8;   // самый короткий префикс для D-Bus Ban
+
+  // Имя таблицы или набора подставляется в команды nft как есть
+  static bool validName(const std::string &name);
+};
+
+// Блокировка через nftables: своя таблица с набором IPv4-адресов, у
+// каждого элемента свой timeout, и ядро удаляет его само. Адреса
+// копятся в очереди и уходят из отдельного потока одной транзакцией
+// (одним netlink-коммитом) на пачку: тысячи блокировок в секунду во
+// время флуда ботнета не задерживают ни главный цикл, ни захват.
+// Префиксы живут в соседнем наборе <set>_net с flags interval и
+// уходят по одному; интервалы в наборе не пересекаются, поэтому
+// префикс, накрывший уже стоящие, снимает их той же транзакцией.
+//
+// add не продлевает элемент, который уже стоит в наборе, поэтому поток
+// коммитов помнит, что и до какого времени стоит в ядре: повторный ban
+// живого элемента уходит парой delete + add в одной транзакции.
+class nftmitigator {
+public:
+  explicit nftmitigator(const MitigationConfig &config);
+  virtual ~nftmitigator();
+
+  // Создаёт таблицу, набор и правило drop и запускает поток коммитов
+  bool start();
+  // Дописывает очередь и, если не keep_on_exit, удаляет таблицу
+  void stop();
+  // Сетевой порядок, network уже под маской; не блокируется на netlink.
+  // Повторный вызов продлевает блокировку на timeout.
+  void ban(uint32_t network, uint8_t length = 32);
+
+  uint64_t banned() const { return banned_count.load(); }
+  uint64_t commits() const { return commit_count.load(); }
+  uint64_t failures() const { return failure_count.load(); }
+
+protected:
+  using Prefix = std::pair<uint32_t, uint8_t>; // адрес, длина
+  using Clock = std::chrono::steady_clock;
+
+  void commit(std::vector<Prefix> &batch);
+  virtual bool execute(const std::string &commands);
+
+private:
+  void run();
+  void prune(Clock::time_point now);
+  std::string elements(const char *verb, const std::string &set,
+                       const std::vector<Prefix> &list) const;
+  // Одна транзакция: delete removed, затем add added
+  bool replace(const std::string &set, const std::vector<Prefix> &removed,
+               const std::vector<Prefix> &added);
+
+  MitigationConfig config;
+  nft_ctx *ctx = nullptr;
+
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable wakeup;
+  std::vector<Prefix> pending;
+  bool stopping = false;
+
+  // Что стоит в ядре и до какого времени; только поток коммитов
+  std::unordered_map<uint32_t, Clock::time_point> live_addresses;
+  std::map<Prefix, Clock::time_point> live_prefixes;
+  Clock::time_point next_prune;
+
+  std::atomic<uint64_t> banned_count{0};
+  std::atomic<uint64_t> commit_count{0};
+  std::atomic<uint64_t> failure_count{0};
+};
+
+#endif // NFTMITIGATOR_H
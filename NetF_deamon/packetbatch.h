@@ -0,0 +1,23 @@
+#ifndef PACKETBATCH_H
+#define PACKETBATCH_H
+
+#include <cstddef>
+#include <pcap.h>
+#include <sys/types.h>
+
+// Пачка пакетов, которую бэкенд захвата отдаёт firewall за один вызов.
+// data[i] указывает либо прямо в mmap-кольцо, либо в storage, если
+// бэкенд не гарантирует жизнь буфера после колбэка (libpcap).
+struct PacketBatch {
+  static constexpr size_t capacity = 256;
+  static constexpr size_t slot_size = 128; // хватает на Ethernet+IP+TCP
+
+  const u_char *data[capacity];
+  struct pcap_pkthdr headers[capacity];
+  size_t count = 0;
+
+  bool full() const { return count == capacity; }
+  void clear() { count = 0; }
+};
+
+#endif // PACKETBATCH_H
@@ -0,0 +1,57 @@
+#include "packetcapture.h"
+#include "pcapcapture.h"
+#include "replaycapture.h"
+#include "ringcapture.h"
+#include <iostream>
+
+std::unique_ptr<packetcapture>
+packetcapture::create(const CaptureConfig &config) {
+  if (!config.replay_file.empty()) {
+    auto replay = std::make_unique<replaycapture>(config);
+    if (replay->open()) {
+      return replay;
+    }
+    return nullptr;
+  }
+
+  if (config.backend == "ring") {
+    auto ring = std::make_unique<ringcapture>(config);
+    if (ring->open()) {
+      return ring;
+    }
+    std::cerr << "TPACKET_V3 ring unavailable, falling back to libpcap"
+              << std::endl;
+  } else if (config.backend != "pcap") {
+    std::cerr << "Unknown capture backend '" << config.backend
+              << "', using libpcap" << std::endl;
+  }
+
+  auto pcap = std::make_unique<pcapcapture>(config);
+  if (pcap->open()) {
+    return pcap;
+  }
+  return nullptr;
+}
+
+void packetcapture::setFilter(std::vector<struct sock_filter> program) {
+  std::lock_guard<std::mutex> lock(filter_mutex);
+  pending_filter = std::move(program);
+  filter_pending.store(true, std::memory_order_release);
+}
+
+void packetcapture::applyPendingFilter() {
+  if (!filter_pending.load(std::memory_order_acquire)) {
+    return;
+  }
+
+  std::vector<struct sock_filter> program;
+  {
+    std::lock_guard<std::mutex> lock(filter_mutex);
+    program.swap(pending_filter);
+    filter_pending.store(false, std::memory_order_relaxed);
+  }
+  if (!installFilter(program)) {
+    std::cerr << name() << ": failed to install prefilter, capturing unfiltered"
+              << std::endl;
+  }
+}
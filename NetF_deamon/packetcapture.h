@@ -0,0 +1,78 @@
+#ifndef PACKETCAPTURE_H
+#define PACKETCAPTURE_H
+
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include <linux/filter.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class firewall;
+
+struct CaptureConfig {
+  std::string interface = "lo";
+  std::string backend = "ring"; // "ring" (AF_PACKET TPACKET_V3) или "pcap"
+  uint32_t block_size = 1 << 22;
+  uint32_t frame_size = 2048;
+  uint32_t frame_count = 1 << 16;
+  uint32_t block_timeout_ms = 10;
+  uint32_t workers = 0;      // 0 - по числу ядер
+  uint32_t fanout_group = 0; // 0 - выбрать по pid
+  bool prefilter = true;     // BPF-фильтр в ядре по включённым детекторам
+  // Часы детекторов: "coarse" - грубое системное время раз на пачку,
+  // "event" - метки времени пакетов. Replay всегда идёт по "event".
+  std::string clock = "coarse";
+
+  // Параметры libpcap-бэкенда. Детекторы читают только заголовки, поэтому
+  // snaplen по умолчанию обрезает полезную нагрузку.
+  uint32_t snaplen = 128;
+  uint32_t buffer_size = 16 << 20;
+  uint32_t pcap_timeout_ms = 10;
+  bool immediate_mode = false;
+
+  // Офлайн-прогон: если задан файл, вместо интерфейса читается он.
+  // replay_speed == 0 - максимальная скорость, иначе множитель времени.
+  std::string replay_file;
+  double replay_speed = 0;
+};
+
+struct CaptureStats {
+  uint64_t packets = 0;
+  uint64_t drops = 0;
+};
+
+// Общий интерфейс источников пакетов: каждый бэкенд сам крутит цикл
+// приёма и отдаёт пакеты в analyzePacket своего воркера до установки
+// stop_flag.
+class packetcapture {
+public:
+  virtual ~packetcapture() = default;
+
+  virtual bool open() = 0;
+  virtual void run(firewall &detector,
+                   const volatile sig_atomic_t &stop_flag) = 0;
+  virtual bool supportsFanout() const { return false; }
+  virtual CaptureStats stats() = 0;
+  virtual const char *name() const = 0;
+
+  // Можно вызывать из любого потока: фильтр ставится воркером между
+  // пачками, чтобы не трогать хэндл захвата параллельно с run().
+  void setFilter(std::vector<struct sock_filter> program);
+
+  static std::unique_ptr<packetcapture> create(const CaptureConfig &config);
+
+protected:
+  void applyPendingFilter();
+  virtual bool
+  installFilter(const std::vector<struct sock_filter> &program) = 0;
+
+private:
+  std::mutex filter_mutex;
+  std::vector<struct sock_filter> pending_filter;
+  std::atomic<bool> filter_pending{false};
+};
+
+#endif // PACKETCAPTURE_H
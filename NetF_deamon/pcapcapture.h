@@ -0,0 +1,36 @@
+#ifndef PCAPCAPTURE_H
+#define PCAPCAPTURE_H
+
+#include "packetbatch.h"
+#include "packetcapture.h"
+#include <pcap.h>
+
+// Запасной бэкенд на libpcap для систем, где AF_PACKET-кольцо недоступно.
+// Пакеты забираются пачками через pcap_dispatch и отдаются firewall
+// одним вызовом analyzeBatch.
+class pcapcapture : public packetcapture {
+public:
+  explicit pcapcapture(const CaptureConfig &config);
+  ~pcapcapture() override;
+
+  bool open() override;
+  void run(firewall &detector,
+           const volatile sig_atomic_t &stop_flag) override;
+  CaptureStats stats() override;
+  const char *name() const override { return "libpcap"; }
+
+protected:
+  bool installFilter(const std::vector<struct sock_filter> &program) override;
+
+private:
+  static void collectPacket(u_char *user, const struct pcap_pkthdr *header,
+                            const u_char *packet);
+
+  CaptureConfig config;
+  pcap_t *handle = nullptr;
+  CaptureStats totals;
+  PacketBatch batch;
+  u_char storage[PacketBatch::capacity][PacketBatch::slot_size];
+};
+
+#endif // PCAPCAPTURE_H
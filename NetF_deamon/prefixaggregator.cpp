@@ -0,0 +1,170 @@
+#include "prefixaggregator.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstdio>
+#include <sstream>
+
+bool AggregateConfig::parseLevels(const std::string &text,
+                                  std::vector<AggregateLevel> &levels) {
+  std::vector<AggregateLevel> parsed;
+  std::stringstream in(text);
+  std::string item;
+  while (std::getline(in, item, ',')) {
+    unsigned prefix;
+    unsigned members;
+    char tail;
+    if (sscanf(item.c_str(), " %u : %u %c", &prefix, &members, &tail) != 2 ||
+        prefix == 0 || prefix >= 32 || members < 2) {
+      return false;
+    }
+    parsed.push_back({uint8_t(prefix), members});
+  }
+  levels = parsed;
+  return true;
+}
+
+prefixaggregator::prefixaggregator(const AggregateConfig &config,
+                                   uint32_t ttl)
+    : levels(config.enabled ? config.levels : std::vector<AggregateLevel>()),
+      ttl(ttl), counts(levels.size()) {
+  std::sort(levels.begin(), levels.end(),
+            [](const AggregateLevel &a, const AggregateLevel &b) {
+              return a.prefix < b.prefix;
+            });
+}
+
+void prefixaggregator::schedule(uint64_t key, TimerKind kind, uint32_t until,
+                                uint32_t seconds, uint32_t tag) {
+  timers.schedule(key, kind, EventTime(until + 1) * USEC_PER_SEC,
+                  EventTime(seconds) * USEC_PER_SEC, tag);
+}
+
+// Срабатывает самый короткий префикс, набравший своих членов: он и есть
+// наименьший префикс, покрывающий всю группу. Ранее включённые префиксы
+// внутри него больше не нужны.
+bool prefixaggregator::addMember(uint32_t ip, uint32_t seconds,
+                                 Prefix &activated) {
+  if (levels.empty()) {
+    return false;
+  }
+  const uint32_t host = ntohl(ip);
+  const uint32_t until = seconds + ttl;
+  auto [member, inserted] = members.try_emplace(host, until);
+  if (inserted) {
+    schedule(host, MEMBER_TIMER, until, seconds);
+    for (size_t level = 0; level < levels.size(); ++level) {
+      ++counts[level][host & prefixtrie<Block>::maskOf(levels[level].prefix)];
+    }
+  } else {
+    member->second = until;
+  }
+
+  for (size_t level = 0; level < levels.size(); ++level) {
+    const uint8_t length = levels[level].prefix;
+    const uint32_t network = host & prefixtrie<Block>::maskOf(length);
+    const uint32_t count = counts[level][network];
+    if (count < levels[level].members) {
+      continue;
+    }
+
+    uint8_t covered_length;
+    if (Block *block = blocks.match(host, &covered_length);
+        block && covered_length <= length) {
+      block->until = until;
+      if (covered_length == length) {
+        block->members = count;
+      }
+      return false;
+    }
+
+    std::vector<std::pair<uint32_t, uint8_t>> inner;
+    blocks.forEachWithin(network, length,
+                         [&](uint32_t bits, uint8_t inner_length,
+                             const Block &) {
+                           inner.emplace_back(bits, inner_length);
+                         });
+    for (const auto &[bits, inner_length] : inner) {
+      blocks.erase(bits, inner_length);
+    }
+    // Таймеры свёрнутых внутренних префиксов остаются в колесе: по
+    // поколению они не тронут префикс, включённый заново
+    const uint32_t generation = ++timer_generation;
+    blocks.insert(network, length, Block{until, count, until, generation});
+    schedule(uint64_t(network) << 8 | length, BLOCK_TIMER, until, seconds,
+             generation);
+    activated = Prefix{htonl(network), length, count};
+    return true;
+  }
+  return false;
+}
+
+// Как у firewall::blockSource: продление уходит в ядро, когда запись там
+// прожила половину срока, а не с каждым алертом
+bool prefixaggregator::refresh(uint32_t ip, uint32_t seconds,
+                               Prefix &prefix) {
+  uint8_t length;
+  Block *block = blocks.match(ntohl(ip), &length);
+  if (!block || block->mitigated >= seconds + ttl / 2) {
+    return false;
+  }
+  block->until = std::max(block->until, seconds + ttl);
+  block->mitigated = block->until;
+  prefix = Prefix{ip & htonl(prefixtrie<Block>::maskOf(length)), length,
+                  block->members};
+  return true;
+}
+
+bool prefixaggregator::covering(uint32_t ip, Prefix &prefix) const {
+  uint8_t length;
+  const Block *block = blocks.match(ntohl(ip), &length);
+  if (!block) {
+    return false;
+  }
+  prefix = Prefix{ip & htonl(prefixtrie<Block>::maskOf(length)), length,
+                  block->members};
+  return true;
+}
+
+void prefixaggregator::expire(uint32_t seconds) {
+  timers.advance(EventTime(seconds) * USEC_PER_SEC, SIZE_MAX,
+                 [&](const timerwheel::Timer &timer) {
+                   expireTimer(timer, seconds);
+                 });
+}
+
+void prefixaggregator::expireTimer(const timerwheel::Timer &timer,
+                                   uint32_t seconds) {
+  if (timer.kind == MEMBER_TIMER) {
+    const uint32_t host = timer.key;
+    auto it = members.find(host);
+    if (it == members.end()) {
+      return;
+    }
+    if (seconds <= it->second) {
+      schedule(host, MEMBER_TIMER, it->second, seconds);
+      return;
+    }
+    members.erase(it);
+    for (size_t level = 0; level < levels.size(); ++level) {
+      auto &count = counts[level];
+      auto network =
+          count.find(host & prefixtrie<Block>::maskOf(levels[level].prefix));
+      if (network != count.end() && --network->second == 0) {
+        count.erase(network);
+      }
+    }
+    return;
+  }
+
+  const uint32_t network = timer.key >> 8;
+  const uint8_t length = timer.key & 0xff;
+  Block *block = blocks.find(network, length);
+  if (!block || block->timer != timer.tag) {
+    return; // префикс свёрнут, у включённого заново свой таймер
+  }
+  if (seconds <= block->until) {
+    schedule(timer.key, BLOCK_TIMER, block->until, seconds, timer.tag);
+    return;
+  }
+  blocks.erase(network, length);
+}
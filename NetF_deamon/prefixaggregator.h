@@ -0,0 +1,86 @@
+#ifndef PREFIXAGGREGATOR_H
+#define PREFIXAGGREGATOR_H
+
+#include "prefixtrie.h"
+#include "timerwheel.h"
+#include <arpa/inet.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Уровень агрегации: префикс блокируется целиком, когда в нём набралось
+// members заблокированных адресов
+struct AggregateLevel {
+  uint8_t prefix;
+  uint32_t members;
+};
+
+struct AggregateConfig {
+  bool enabled = true;
+  std::vector<AggregateLevel> levels = {{24, 8}, {16, 64}};
+
+  // "24:8, 16:64" -> levels, false при ошибке
+  static bool parseLevels(const std::string &text,
+                          std::vector<AggregateLevel> &levels);
+};
+
+// Сворачивает заблокированные адреса в префиксы. Воркеры делят источники
+// между собой, поэтому члены одной /24 разбросаны по ним; агрегатор
+// работает на медленном пути и видит адреса всех воркеров. Активные
+// префиксы хранятся в дереве с поиском самого длинного совпадения,
+// истечение - по колесу таймеров, как в firewall.
+class prefixaggregator {
+public:
+  struct Prefix {
+    uint32_t network; // сетевой порядок
+    uint8_t length;
+    uint32_t members;
+  };
+
+  prefixaggregator(const AggregateConfig &config, uint32_t ttl);
+
+  // Учитывает заблокированный адрес (сетевой порядок). true - из-за него
+  // включился новый префикс, он возвращается в activated.
+  bool addMember(uint32_t ip, uint32_t seconds, Prefix &activated);
+  // Повторная блокировка адреса: true - покрывающий его префикс прожил
+  // в ядре половину срока и уходит туда заново, он возвращается в prefix
+  bool refresh(uint32_t ip, uint32_t seconds, Prefix &prefix);
+  // Активный префикс, покрывающий адрес
+  bool covering(uint32_t ip, Prefix &prefix) const;
+  void expire(uint32_t seconds);
+
+  size_t memberCount() const { return members.size(); }
+  size_t prefixCount() const { return blocks.size(); }
+
+  template <typename Fn> void forEachPrefix(Fn fn) const {
+    blocks.forEach([&](uint32_t network, uint8_t length, const Block &block) {
+      fn(Prefix{htonl(network), length, block.members}, block.until);
+    });
+  }
+
+private:
+  enum TimerKind : uint32_t { MEMBER_TIMER, BLOCK_TIMER };
+
+  struct Block {
+    uint32_t until;
+    uint32_t members;
+    uint32_t mitigated; // до когда держится запись в nftables и XDP
+    uint32_t timer;     // поколение своего таймера
+  };
+
+  void schedule(uint64_t key, TimerKind kind, uint32_t until,
+                uint32_t seconds, uint32_t tag = 0);
+  void expireTimer(const timerwheel::Timer &timer, uint32_t seconds);
+
+  std::vector<AggregateLevel> levels; // от коротких префиксов к длинным
+  uint32_t ttl;
+  std::unordered_map<uint32_t, uint32_t> members; // адрес -> до, секунды
+  // По уровню: сеть -> число заблокированных адресов в ней
+  std::vector<std::unordered_map<uint32_t, uint32_t>> counts;
+  prefixtrie<Block> blocks; // адреса в порядке хоста
+  timerwheel timers{USEC_PER_SEC};
+  uint32_t timer_generation = 0;
+};
+
+#endif // PREFIXAGGREGATOR_H
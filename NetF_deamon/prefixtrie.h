@@ -0,0 +1,236 @@
+#ifndef PREFIXTRIE_H
+#define PREFIXTRIE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Бинарное дерево префиксов IPv4 со сжатием путей: узел хранит префикс
+// целиком, цепочки узлов с одним потомком не образуются. Поиск самого
+// длинного совпадения - не больше 33 узлов и обычно намного меньше.
+// Адреса и префиксы - в порядке хоста. Узлы живут в одном векторе и
+// ссылаются друг на друга индексами, освободившиеся идут повторно.
+template <typename Value> class prefixtrie {
+public:
+  prefixtrie() { nodes.push_back(Node{}); }
+
+  static uint32_t maskOf(uint8_t length) {
+    return length == 0 ? 0 : ~uint32_t(0) << (32 - length);
+  }
+
+  size_t size() const { return count; }
+
+  // Вставляет или заменяет значение для network/length
+  Value &insert(uint32_t network, uint8_t length, const Value &value) {
+    network &= maskOf(length);
+    uint32_t index = 0;
+    for (;;) {
+      if (nodes[index].length == length) {
+        return assign(index, value);
+      }
+      const int bit = bitAt(network, nodes[index].length);
+      uint32_t child = nodes[index].child[bit];
+      if (child == 0) {
+        uint32_t leaf = allocate(network, length);
+        nodes[index].child[bit] = leaf;
+        return assign(leaf, value);
+      }
+
+      const uint8_t common = commonLength(nodes[child].bits,
+                                          nodes[child].length, network, length);
+      if (common == nodes[child].length) {
+        index = child;
+        continue;
+      }
+
+      // Префиксы разошлись внутри сжатого пути: путь делится узлом на
+      // общей части, и новый префикс либо встаёт в него, либо рядом
+      uint32_t split = allocate(network & maskOf(common), common);
+      nodes[split].child[bitAt(nodes[child].bits, common)] = child;
+      nodes[index].child[bit] = split;
+      if (common == length) {
+        return assign(split, value);
+      }
+      uint32_t leaf = allocate(network, length);
+      nodes[split].child[bitAt(network, common)] = leaf;
+      return assign(leaf, value);
+    }
+  }
+
+  // Значение самого длинного префикса, покрывающего адрес
+  const Value *match(uint32_t ip, uint8_t *length = nullptr) const {
+    const Node *best = nodes[0].has_value ? &nodes[0] : nullptr;
+    uint32_t index = 0;
+    while (nodes[index].length < 32) {
+      uint32_t child = nodes[index].child[bitAt(ip, nodes[index].length)];
+      if (child == 0 ||
+          (ip & maskOf(nodes[child].length)) != nodes[child].bits) {
+        break;
+      }
+      index = child;
+      if (nodes[index].has_value) {
+        best = &nodes[index];
+      }
+    }
+    if (best && length) {
+      *length = best->length;
+    }
+    return best ? &best->value : nullptr;
+  }
+
+  Value *match(uint32_t ip, uint8_t *length = nullptr) {
+    return const_cast<Value *>(std::as_const(*this).match(ip, length));
+  }
+
+  Value *find(uint32_t network, uint8_t length) {
+    network &= maskOf(length);
+    uint32_t index = 0;
+    while (nodes[index].length < length) {
+      uint32_t child = nodes[index].child[bitAt(network, nodes[index].length)];
+      if (child == 0 || nodes[child].length > length ||
+          (network & maskOf(nodes[child].length)) != nodes[child].bits) {
+        return nullptr;
+      }
+      index = child;
+    }
+    Node &node = nodes[index];
+    return node.length == length && node.has_value ? &node.value : nullptr;
+  }
+
+  bool erase(uint32_t network, uint8_t length) {
+    network &= maskOf(length);
+    uint32_t parent = 0;
+    uint32_t index = 0;
+    while (nodes[index].length < length) {
+      uint32_t child = nodes[index].child[bitAt(network, nodes[index].length)];
+      if (child == 0 || nodes[child].length > length ||
+          (network & maskOf(nodes[child].length)) != nodes[child].bits) {
+        return false;
+      }
+      parent = index;
+      index = child;
+    }
+    if (nodes[index].length != length || !nodes[index].has_value) {
+      return false;
+    }
+    nodes[index].has_value = false;
+    nodes[index].value = Value{};
+    --count;
+    prune(parent, index);
+    return true;
+  }
+
+  // Обходит все значения внутри network/length, включая его самого
+  template <typename Fn>
+  void forEachWithin(uint32_t network, uint8_t length, Fn fn) const {
+    network &= maskOf(length);
+    uint32_t index = 0;
+    while (nodes[index].length < length) {
+      uint32_t child = nodes[index].child[bitAt(network, nodes[index].length)];
+      if (child == 0) {
+        return;
+      }
+      const Node &node = nodes[child];
+      const uint8_t common = commonLength(node.bits, node.length, network,
+                                          length);
+      if (common < std::min(node.length, length)) {
+        return;
+      }
+      index = child;
+    }
+    walk(index, fn);
+  }
+
+  template <typename Fn> void forEach(Fn fn) const { walk(0, fn); }
+
+private:
+  struct Node {
+    uint32_t bits = 0; // префикс, биты за length обнулены
+    uint8_t length = 0;
+    bool has_value = false;
+    uint32_t child[2] = {0, 0}; // 0 - нет потомка (корень им не бывает)
+    Value value{};
+  };
+
+  static int bitAt(uint32_t ip, uint8_t position) {
+    return (ip >> (31 - position)) & 1;
+  }
+
+  static uint8_t commonLength(uint32_t a, uint8_t a_length, uint32_t b,
+                              uint8_t b_length) {
+    uint8_t limit = std::min(a_length, b_length);
+    uint32_t diff = a ^ b;
+    uint8_t same = diff == 0 ? 32 : __builtin_clz(diff);
+    return std::min(limit, same);
+  }
+
+  Value &assign(uint32_t index, const Value &value) {
+    if (!nodes[index].has_value) {
+      nodes[index].has_value = true;
+      ++count;
+    }
+    nodes[index].value = value;
+    return nodes[index].value;
+  }
+
+  uint32_t allocate(uint32_t bits, uint8_t length) {
+    uint32_t index;
+    if (free_nodes.empty()) {
+      index = nodes.size();
+      nodes.emplace_back();
+    } else {
+      index = free_nodes.back();
+      free_nodes.pop_back();
+      nodes[index] = Node{};
+    }
+    nodes[index].bits = bits;
+    nodes[index].length = length;
+    return index;
+  }
+
+  // Узел без значения с одним потомком или без них больше не нужен:
+  // его место занимает потомок, и сжатие путей сохраняется
+  void prune(uint32_t parent, uint32_t index) {
+    if (index == 0) {
+      return;
+    }
+    Node &node = nodes[index];
+    if (node.has_value || (node.child[0] && node.child[1])) {
+      return;
+    }
+    uint32_t heir = node.child[0] ? node.child[0] : node.child[1];
+    Node &up = nodes[parent];
+    up.child[up.child[0] == index ? 0 : 1] = heir;
+    free_nodes.push_back(index);
+
+    // Родитель мог остаться промежуточным узлом с одним потомком
+    if (heir == 0 && parent != 0 && !up.has_value) {
+      uint32_t grand = 0;
+      uint32_t at = 0;
+      while (at != parent) {
+        grand = at;
+        at = nodes[at].child[bitAt(up.bits, nodes[at].length)];
+      }
+      prune(grand, parent);
+    }
+  }
+
+  template <typename Fn> void walk(uint32_t index, Fn &fn) const {
+    const Node &node = nodes[index];
+    if (node.has_value) {
+      fn(node.bits, node.length, node.value);
+    }
+    for (uint32_t child : node.child) {
+      if (child) {
+        walk(child, fn);
+      }
+    }
+  }
+
+  std::vector<Node> nodes; // nodes[0] - корень, префикс /0
+  std::vector<uint32_t> free_nodes;
+  size_t count = 0;
+};
+
+#endif // PREFIXTRIE_H
@@ -0,0 +1,35 @@
+#ifndef REPLAYCAPTURE_H
+#define REPLAYCAPTURE_H
+
+#include "packetbatch.h"
+#include "packetcapture.h"
+#include <pcap.h>
+
+// Прогон записанного pcap-файла через те же детекторы, что и живой захват.
+// speed == 0 - максимальная скорость с замером pkt/s и ns/пакет,
+// иначе пакеты отдаются по их меткам времени, ускоренным в speed раз.
+class replaycapture : public packetcapture {
+public:
+  explicit replaycapture(const CaptureConfig &config);
+  ~replaycapture() override;
+
+  bool open() override;
+  void run(firewall &detector,
+           const volatile sig_atomic_t &stop_flag) override;
+  CaptureStats stats() override { return totals; }
+  const char *name() const override { return "pcap replay"; }
+
+protected:
+  bool installFilter(const std::vector<struct sock_filter> &program) override;
+
+private:
+  void push(const struct pcap_pkthdr *header, const u_char *packet);
+
+  CaptureConfig config;
+  pcap_t *handle = nullptr;
+  CaptureStats totals;
+  PacketBatch batch;
+  u_char storage[PacketBatch::capacity][PacketBatch::slot_size];
+};
+
+#endif // REPLAYCAPTURE_H
@@ -0,0 +1,265 @@
+#include "ringcapture.h"
+#include "firewall.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+ringcapture::ringcapture(const CaptureConfig &config) : config(config) {}
+
+ringcapture::~ringcapture() { close(); }
+
+void ringcapture::close() {
+  if (ring) {
+    munmap(ring, ring_size);
+    ring = nullptr;
+  }
+  if (fd >= 0) {
+    ::close(fd);
+    fd = -1;
+  }
+}
+
+bool ringcapture::open() {
+  if (config.frame_size < TPACKET3_HDRLEN ||
+      config.block_size % config.frame_size != 0 ||
+      config.block_size % getpagesize() != 0) {
+    std::cerr << "Ring error: block_size must be a multiple of the page size "
+                 "and of frame_size"
+              << std::endl;
+    return false;
+  }
+
+  uint64_t ring_bytes = uint64_t(config.frame_count) * config.frame_size;
+  block_count = (ring_bytes + config.block_size - 1) / config.block_size;
+  if (block_count == 0) {
+    block_count = 1;
+  }
+
+  fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+  if (fd < 0) {
+    std::cerr << "Ring error: socket: " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  int version = TPACKET_V3;
+  if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) <
+      0) {
+    std::cerr << "Ring error: PACKET_VERSION: " << strerror(errno)
+              << std::endl;
+    close();
+    return false;
+  }
+
+  struct tpacket_req3 req = {};
+  req.tp_block_size = config.block_size;
+  req.tp_block_nr = block_count;
+  req.tp_frame_size = config.frame_size;
+  req.tp_frame_nr = block_count * (config.block_size / config.frame_size);
+  req.tp_retire_blk_tov = config.block_timeout_ms;
+  if (setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+    std::cerr << "Ring error: PACKET_RX_RING: " << strerror(errno)
+              << std::endl;
+    close();
+    return false;
+  }
+
+  ring_size = size_t(req.tp_block_size) * req.tp_block_nr;
+  void *map = mmap(nullptr, ring_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, 0);
+  if (map == MAP_FAILED) {
+    std::cerr << "Ring error: mmap: " << strerror(errno) << std::endl;
+    ring = nullptr;
+    close();
+    return false;
+  }
+  ring = static_cast<uint8_t *>(map);
+
+  struct ifreq ifr = {};
+  strncpy(ifr.ifr_name, config.interface.c_str(), IFNAMSIZ - 1);
+  if (ioctl(fd, SIOCGIFINDEX, &ifr) < 0) {
+    std::cerr << "Ring error: unknown interface " << config.interface
+              << std::endl;
+    close();
+    return false;
+  }
+
+  struct sockaddr_ll sll = {};
+  sll.sll_family = AF_PACKET;
+  sll.sll_protocol = htons(ETH_P_ALL);
+  sll.sll_ifindex = ifr.ifr_ifindex;
+
+  loopback =
+      ioctl(fd, SIOCGIFFLAGS, &ifr) == 0 && (ifr.ifr_flags & IFF_LOOPBACK);
+
+  if (bind(fd, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+    std::cerr << "Ring error: bind: " << strerror(errno) << std::endl;
+    close();
+    return false;
+  }
+
+  if (config.workers > 1 && !joinFanout()) {
+    close();
+    return false;
+  }
+
+  current_block = 0;
+  return true;
+}
+
+// Все воркеры входят в одну fanout-группу. Распределение делает cBPF:
+// хэш от IPv4-адреса источника, ядро берёт его по модулю числа сокетов.
+// Так все пакеты одного источника попадают в один воркер и его
+// состояние детекторов не нужно синхронизировать. Исключение - SYN-ACK
+// и RST-ACK (ответ закрытого порта на SYN): они хэшируются по адресу
+// назначения и попадают к воркеру клиента, который видел SYN этого
+// потока (flowtable).
+//
+// Принятый пакет программа видит с IP-заголовка, исходящий - с
+// Ethernet, поэтому протокол берётся из skb, а поля - от сетевого
+// заголовка (SKF_NET_OFF).
+bool ringcapture::joinFanout() {
+  int fanout = (config.fanout_group & 0xffff) | (PACKET_FANOUT_CBPF << 16);
+  if (setsockopt(fd, SOL_PACKET, PACKET_FANOUT, &fanout, sizeof(fanout)) < 0) {
+    std::cerr << "Ring error: PACKET_FANOUT: " << strerror(errno) << std::endl;
+    return false;
+  }
+
+  const uint32_t protocol = SKF_AD_OFF + SKF_AD_PROTOCOL;
+  const uint32_t ip = SKF_NET_OFF;
+  struct sock_filter code[] = {
+      BPF_STMT(BPF_LD | BPF_H | BPF_ABS, protocol),
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_IP, 1, 0),
+      BPF_STMT(BPF_RET | BPF_K, 0),
+      // TCP, первый фрагмент, SYN-ACK или RST-ACK - адрес назначения
+      BPF_STMT(BPF_LD | BPF_B | BPF_ABS, ip + 9),
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_TCP, 0, 9),
+      BPF_STMT(BPF_LD | BPF_H | BPF_ABS, ip + 6),
+      BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K, 0x1fff, 7, 0),
+      BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, ip),
+      BPF_STMT(BPF_LD | BPF_B | BPF_IND, ip + 13),
+      BPF_STMT(BPF_ALU | BPF_AND | BPF_K, TH_SYN | TH_ACK | TH_RST),
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, TH_SYN | TH_ACK, 1, 0),
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, TH_RST | TH_ACK, 0, 2),
+      BPF_STMT(BPF_LD | BPF_W | BPF_ABS, ip + 16),
+      BPF_JUMP(BPF_JMP | BPF_JA, 1, 0, 0),
+      BPF_STMT(BPF_LD | BPF_W | BPF_ABS, ip + 12),
+      BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, 0x9e3779b1),
+      BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 16),
+      BPF_STMT(BPF_RET | BPF_A, 0),
+  };
+  struct sock_fprog prog = {};
+  prog.len = sizeof(code) / sizeof(code[0]);
+  prog.filter = code;
+  if (setsockopt(fd, SOL_PACKET, PACKET_FANOUT_DATA, &prog, sizeof(prog)) <
+      0) {
+    std::cerr << "Ring error: PACKET_FANOUT_DATA: " << strerror(errno)
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void ringcapture::walkBlock(firewall &detector,
+                            struct tpacket_block_desc *block) {
+  uint32_t num_pkts = block->hdr.bh1.num_pkts;
+  auto *ppd = (struct tpacket3_hdr *)((uint8_t *)block +
+                                      block->hdr.bh1.offset_to_first_pkt);
+
+  // Блок принадлежит нам до возврата в ядро, поэтому в пачку кладутся
+  // указатели прямо в кольцо
+  batch.clear();
+  for (uint32_t i = 0; i < num_pkts; ++i) {
+    // На loopback каждый пакет виден дважды (исходящий и входящий), libpcap
+    // отбрасывает исходящие - делаем так же, чтобы счётчики совпадали.
+    // PACKET_IGNORE_OUTGOING тут не подходит: fanout-группа его не учитывает.
+    if (loopback) {
+      auto *sll = (struct sockaddr_ll *)((uint8_t *)ppd +
+                                         TPACKET_ALIGN(sizeof(*ppd)));
+      if (sll->sll_pkttype == PACKET_OUTGOING) {
+        ppd = (struct tpacket3_hdr *)((uint8_t *)ppd + ppd->tp_next_offset);
+        continue;
+      }
+    }
+
+    struct pcap_pkthdr &header = batch.headers[batch.count];
+    header.ts.tv_sec = ppd->tp_sec;
+    header.ts.tv_usec = ppd->tp_nsec / 1000;
+    header.caplen = ppd->tp_snaplen;
+    header.len = ppd->tp_len;
+    batch.data[batch.count++] = (const u_char *)ppd + ppd->tp_mac;
+    totals.packets++;
+
+    if (batch.full()) {
+      detector.analyzeBatch(batch);
+      batch.clear();
+    }
+
+    ppd = (struct tpacket3_hdr *)((uint8_t *)ppd + ppd->tp_next_offset);
+  }
+  if (batch.count > 0) {
+    detector.analyzeBatch(batch);
+  }
+}
+
+void ringcapture::run(firewall &detector,
+                      const volatile sig_atomic_t &stop_flag) {
+  struct pollfd pfd = {};
+  pfd.fd = fd;
+  pfd.events = POLLIN | POLLERR;
+
+  while (!stop_flag) {
+    applyPendingFilter();
+
+    auto *block = (struct tpacket_block_desc *)(ring + size_t(current_block) *
+                                                           config.block_size);
+
+    if ((__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) &
+         TP_STATUS_USER) == 0) {
+      if (poll(&pfd, 1, 100) == 0) {
+        detector.idle();
+      }
+      continue;
+    }
+
+    walkBlock(detector, block);
+
+    __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL,
+                     __ATOMIC_RELEASE);
+    current_block = (current_block + 1) % block_count;
+  }
+}
+
+bool ringcapture::installFilter(
+    const std::vector<struct sock_filter> &program) {
+  struct sock_fprog prog = {};
+  prog.len = program.size();
+  prog.filter = const_cast<struct sock_filter *>(program.data());
+  if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0) {
+    std::cerr << "Ring error: SO_ATTACH_FILTER: " << strerror(errno)
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+CaptureStats ringcapture::stats() {
+  struct tpacket_stats_v3 st = {};
+  socklen_t len = sizeof(st);
+  if (fd >= 0 &&
+      getsockopt(fd, SOL_PACKET, PACKET_STATISTICS, &st, &len) == 0) {
+    // PACKET_STATISTICS сбрасывается при каждом чтении
+    totals.drops += st.tp_drops;
+  }
+  return totals;
+}
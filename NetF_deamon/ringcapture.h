@@ -0,0 +1,43 @@
+#ifndef RINGCAPTURE_H
+#define RINGCAPTURE_H
+
+#include "packetbatch.h"
+#include "packetcapture.h"
+#include <cstddef>
+#include <cstdint>
+#include <linux/if_packet.h>
+
+// AF_PACKET + TPACKET_V3: ядро складывает пакеты в mmap-блоки, пакеты
+// разбираются прямо из кольца без копирования и без вызова на пакет.
+class ringcapture : public packetcapture {
+public:
+  explicit ringcapture(const CaptureConfig &config);
+  ~ringcapture() override;
+
+  bool open() override;
+  void run(firewall &detector,
+           const volatile sig_atomic_t &stop_flag) override;
+  CaptureStats stats() override;
+  const char *name() const override { return "TPACKET_V3"; }
+  bool supportsFanout() const override { return true; }
+
+protected:
+  bool installFilter(const std::vector<struct sock_filter> &program) override;
+
+private:
+  void walkBlock(firewall &detector, struct tpacket_block_desc *block);
+  bool joinFanout();
+  void close();
+
+  CaptureConfig config;
+  int fd = -1;
+  uint8_t *ring = nullptr;
+  size_t ring_size = 0;
+  uint32_t block_count = 0;
+  uint32_t current_block = 0;
+  bool loopback = false;
+  CaptureStats totals;
+  PacketBatch batch;
+};
+
+#endif // RINGCAPTURE_H
@@ -0,0 +1,59 @@
+#include "ruletable.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <iterator>
+
+static uint32_t windowOf(const Thresholds &t) {
+  uint32_t flood = (2 * t.flood_window_ms + 999) / 1000;
+  return std::max({t.scan_window, t.ssh_window, flood});
+}
+
+ruletable::ruletable(const Rule &defaults, std::vector<SubnetRule> overrides,
+                     accesslist access)
+    : defaults(defaults), overrides(std::move(overrides)),
+      access(std::move(access)) {
+  all_detectors = defaults.detectors;
+  longest_window = windowOf(defaults.thresholds);
+  std::copy(std::begin(defaults.thresholds.flood),
+            std::end(defaults.thresholds.flood), lowest_flood);
+  for (uint32_t i = 0; i < this->overrides.size(); ++i) {
+    const SubnetRule &subnet = this->overrides[i];
+    const Thresholds &t = subnet.rule.thresholds;
+    index.insert(ntohl(subnet.network), subnet.prefix, i);
+    all_detectors |= subnet.rule.detectors;
+    longest_window = std::max(longest_window, windowOf(t));
+    for (int kind = 0; kind < FLOOD_KINDS; ++kind) {
+      lowest_flood[kind] = std::min(lowest_flood[kind], t.flood[kind]);
+    }
+  }
+}
+
+bool ruletable::parseSubnet(const std::string &text, SubnetRule &subnet) {
+  std::string address = text;
+  unsigned long prefix = 32;
+  size_t slash = text.find('/');
+  if (slash != std::string::npos) {
+    address = text.substr(0, slash);
+    std::string bits = text.substr(slash + 1);
+    // Длина проверяется до stoul: длинная строка цифр бросила бы
+    // out_of_range
+    if (bits.empty() || bits.size() > 2 ||
+        bits.find_first_not_of("0123456789") != std::string::npos) {
+      return false;
+    }
+    prefix = std::stoul(bits);
+    if (prefix > 32) {
+      return false;
+    }
+  }
+
+  struct in_addr addr;
+  if (inet_pton(AF_INET, address.c_str(), &addr) != 1) {
+    return false;
+  }
+  uint32_t host_mask = prefix == 0 ? 0 : ~uint32_t(0) << (32 - prefix);
+  subnet.mask = htonl(host_mask);
+  subnet.network = addr.s_addr & subnet.mask;
+  subnet.prefix = prefix;
+  return true;
+}
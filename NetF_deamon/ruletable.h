@@ -0,0 +1,96 @@
+#ifndef RULETABLE_H
+#define RULETABLE_H
+
+#include "accesslist.h"
+#include "detectorset.h"
+#include "prefixtrie.h"
+#include <arpa/inet.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Пороги детекторов. Флуд-пороги заданы на окно flood_window_ms,
+// остальные окна - в секундах.
+struct Thresholds {
+  uint32_t flood[FLOOD_KINDS] = {1, 1, 20, 20, 20, 10}; // по FloodKind
+  uint32_t flood_window_ms = 1000;
+  uint32_t scan_ports = 15;  // различных портов - вертикальный скан
+  uint32_t scan_hosts = 64;  // адресов на одном порту - горизонтальный
+  uint32_t scan_window = 60;
+  uint32_t ssh_connect = 5;     // SYN на 22 порт
+  uint32_t ssh_bruteforce = 10; // сегментов сессии без SYN/FIN/RST
+  uint32_t ssh_window = 60;
+  // Адрес назначения: пакетов всех источников за окно flood_window_ms
+  // и минимум различных источников, чтобы считать флуд распределённым
+  uint32_t target_packets = 10000;
+  uint32_t target_sources = 8;
+  // Полуоткрытых потоков на адрес и порт, после которых смотрится доля
+  // завершённых рукопожатий за окно, в процентах
+  uint32_t half_open = 256;
+  uint32_t min_completion = 50;
+};
+
+struct Rule {
+  Thresholds thresholds;
+  uint32_t detectors = DETECT_ALL;
+};
+
+struct SubnetRule {
+  uint32_t network; // сетевой порядок, уже под маской
+  uint32_t mask;    // сетевой порядок
+  uint8_t prefix;
+  Rule rule;
+};
+
+// Скомпилированные правила: умолчания и переопределения по подсетям.
+// Таблица неизменяема - воркеры держат указатель на свою копию, новая
+// подменяется целиком (RCU), захват при этом не останавливается.
+class ruletable {
+public:
+  explicit ruletable(const Rule &defaults = Rule(),
+                     std::vector<SubnetRule> overrides = {},
+                     accesslist access = accesslist());
+
+  // Решение списков для источника - до всех детекторов
+  Verdict verdict(uint32_t ip) const { return access.lookup(ip); }
+  size_t listedPrefixes() const { return access.size(); }
+
+  // Правило для адреса: самая длинная подходящая подсеть или
+  // умолчания
+  const Rule &match(uint32_t ip) const {
+    if (overrides.empty()) {
+      return defaults;
+    }
+    const uint32_t *slot = index.match(ntohl(ip));
+    return slot ? overrides[*slot].rule : defaults;
+  }
+
+  const Rule &fallback() const { return defaults; }
+
+  // Объединение масок всех правил: по нему собирается префильтр
+  uint32_t detectors() const { return all_detectors; }
+
+  // Самое длинное окно, секунды: столько живёт запись молчащего источника
+  uint32_t longestWindow() const { return longest_window; }
+
+  // Наименьший порог флуда по всем правилам: ниже него скетч не
+  // отчитывается ни об одном адресе
+  uint32_t lowestFlood(FloodKind kind) const { return lowest_flood[kind]; }
+
+  size_t overrideCount() const { return overrides.size(); }
+
+  // "10.0.0.0/8" -> network/mask/prefix, false при ошибке
+  static bool parseSubnet(const std::string &text, SubnetRule &subnet);
+
+private:
+  Rule defaults;
+  std::vector<SubnetRule> overrides;
+  prefixtrie<uint32_t> index; // подсеть -> позиция в overrides
+  accesslist access;
+  uint32_t all_detectors;
+  uint32_t longest_window;
+  uint32_t lowest_flood[FLOOD_KINDS];
+};
+
+#endif // RULETABLE_H
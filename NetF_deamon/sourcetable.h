@@ -0,0 +1,203 @@
+#ifndef SOURCETABLE_H
+#define SOURCETABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// fmix32 из MurmurHash3: младшие биты адресов внутри одной /24 и
+// адреса одного воркера fanout-группы не должны слипаться в кластеры
+inline uint32_t mix32(uint32_t key) {
+  key ^= key >> 16;
+  key *= 0x85ebca6b;
+  key ^= key >> 13;
+  key *= 0xc2b2ae35;
+  key ^= key >> 16;
+  return key;
+}
+
+// fmix64 - для составных ключей (адрес и порт)
+inline uint64_t mix64(uint64_t key) {
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ULL;
+  key ^= key >> 33;
+  return key;
+}
+
+inline size_t hashKey(uint32_t key) { return mix32(key); }
+inline size_t hashKey(uint64_t key) { return mix64(key); }
+
+// Хэш-таблица с открытой адресацией и линейным пробированием для
+// состояния по IPv4-адресу. Память выделяется один раз в конструкторе,
+// вставка не аллоцирует. Удаление - обратным сдвигом, без надгробий,
+// поэтому цепочки проб не деградируют со временем.
+//
+// Record должен содержать поля `key` и `bool used`. Ключ - uint32_t,
+// uint64_t или структура со своей перегрузкой hashKey и operator==.
+// Для вытеснения (findOrReplace) нужно ещё поле `bool referenced`,
+// которое владелец ставит при каждом обращении к записи.
+template <typename Record> class sourcetable {
+public:
+  using Key = decltype(Record::key);
+
+  explicit sourcetable(size_t capacity) {
+    size_t size = 16;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    mask = size - 1;
+    slots = std::make_unique<Record[]>(size);
+  }
+
+  size_t size() const { return count; }
+  size_t capacity() const { return mask + 1; }
+
+  Record *find(Key key) {
+    for (size_t i = hash(key);; i = (i + 1) & mask) {
+      Record &slot = slots[i];
+      if (!slot.used) {
+        return nullptr;
+      }
+      if (slot.key == key) {
+        return &slot;
+      }
+    }
+  }
+
+  // nullptr, если таблица заполнена до предела загрузки
+  Record *findOrInsert(Key key) {
+    size_t i = hash(key);
+    for (;; i = (i + 1) & mask) {
+      Record &slot = slots[i];
+      if (!slot.used) {
+        break;
+      }
+      if (slot.key == key) {
+        return &slot;
+      }
+    }
+    if (count >= maxLoad()) {
+      return nullptr;
+    }
+
+    Record &slot = slots[i];
+    slot = Record{};
+    slot.key = key;
+    slot.used = true;
+    ++count;
+    return &slot;
+  }
+
+  // Как findOrInsert, но заполненная таблица освобождает место по CLOCK:
+  // стрелка идёт по слотам, снимая бит referenced, и останавливается на
+  // первой записи без него. admit(victim) решает, уступит ли жертва
+  // место новому ключу, и освобождает связанное с ней состояние;
+  // nullptr - ключ не допущен.
+  template <typename Admit> Record *findOrReplace(Key key, Admit admit) {
+    if (Record *record = findOrInsert(key)) {
+      return record;
+    }
+    Record *victim = nullptr;
+    while (!victim) {
+      Record &slot = slots[hand];
+      hand = (hand + 1) & mask;
+      if (!slot.used) {
+        continue;
+      }
+      if (slot.referenced) {
+        slot.referenced = false;
+      } else {
+        victim = &slot;
+      }
+    }
+    if (!admit(*victim)) {
+      return nullptr;
+    }
+    erase(victim);
+    return findOrInsert(key);
+  }
+
+  void erase(Record *record) {
+    size_t hole = record - slots.get();
+    slots[hole].used = false;
+    --count;
+
+    // Сдвигаем назад хвост кластера, чтобы поиск не обрывался на дыре
+    for (size_t i = (hole + 1) & mask; slots[i].used; i = (i + 1) & mask) {
+      size_t home = hash(slots[i].key);
+      bool reachable = hole <= i ? (home <= hole || home > i)
+                                 : (home <= hole && home > i);
+      if (reachable) {
+        slots[hole] = slots[i];
+        slots[i].used = false;
+        hole = i;
+      }
+    }
+  }
+
+  void clear() {
+    for (size_t i = 0; i <= mask; ++i) {
+      slots[i].used = false;
+    }
+    count = 0;
+  }
+
+  template <typename Fn> void forEach(Fn fn) {
+    for (size_t i = 0; i <= mask; ++i) {
+      if (slots[i].used) {
+        fn(slots[i]);
+      }
+    }
+  }
+
+  // Обходит steps слотов по кругу начиная с cursor и удаляет записи,
+  // для которых pred вернул true: так истечение размазывается по
+  // вызовам без отдельного таймера на запись. Удаление обратным сдвигом
+  // может перенести в текущий слот запись из хвоста, поэтому после него
+  // слот проверяется ещё раз.
+  template <typename Pred> size_t sweep(size_t &cursor, size_t steps,
+                                        Pred pred) {
+    size_t erased = 0;
+    cursor &= mask;
+    for (size_t step = 0; step < steps && count > 0; ++step) {
+      Record &slot = slots[cursor];
+      if (slot.used && pred(slot)) {
+        erase(&slot);
+        ++erased;
+        continue;
+      }
+      cursor = (cursor + 1) & mask;
+    }
+    return erased;
+  }
+
+  // Удаляет все записи, для которых pred вернул true. Ключи собираются
+  // заранее: обратный сдвиг переставляет записи во время обхода.
+  template <typename Pred> size_t eraseIf(Pred pred) {
+    std::vector<Key> victims;
+    forEach([&](Record &record) {
+      if (pred(record)) {
+        victims.push_back(record.key);
+      }
+    });
+    for (Key key : victims) {
+      erase(find(key));
+    }
+    return victims.size();
+  }
+
+private:
+  size_t hash(Key key) const { return hashKey(key) & mask; }
+
+  size_t maxLoad() const { return (mask + 1) * 3 / 4; }
+
+  std::unique_ptr<Record[]> slots;
+  size_t mask = 0;
+  size_t count = 0;
+  size_t hand = 0; // стрелка CLOCK
+};
+
+#endif // SOURCETABLE_H
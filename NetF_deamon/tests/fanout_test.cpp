@@ -0,0 +1,83 @@
+// Два кольца в одной fanout-группе на lo: пакеты от разных источников
+// должны расходиться по обоим воркерам. Нужен CAP_NET_RAW, без него
+// тест пропускается (код 77).
+#include "firewall.h"
+#include "ringcapture.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <iostream>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+static bool sendFrom(uint32_t source, const sockaddr_in &to) {
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    return false;
+  }
+  sockaddr_in from = {};
+  from.sin_family = AF_INET;
+  from.sin_addr.s_addr = htonl(source);
+  bool ok = bind(fd, (sockaddr *)&from, sizeof(from)) == 0 &&
+            sendto(fd, "x", 1, 0, (const sockaddr *)&to, sizeof(to)) == 1;
+  close(fd);
+  return ok;
+}
+
+int main() {
+  CaptureConfig config;
+  config.interface = "lo";
+  config.workers = 2;
+  config.fanout_group = getpid() & 0xffff;
+  config.block_size = 1 << 16;
+  config.frame_count = 512;
+
+  ringcapture first(config), second(config);
+  if (!first.open() || !second.open()) {
+    std::cerr << "SKIP: cannot open AF_PACKET rings on lo" << std::endl;
+    return 77;
+  }
+
+  volatile sig_atomic_t stop = 0;
+  firewall first_detector, second_detector;
+  std::thread first_worker([&] { first.run(first_detector, stop); });
+  std::thread second_worker([&] { second.run(second_detector, stop); });
+
+  int receiver = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in to = {};
+  to.sin_family = AF_INET;
+  to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  bind(receiver, (sockaddr *)&to, sizeof(to));
+  socklen_t length = sizeof(to);
+  getsockname(receiver, (sockaddr *)&to, &length);
+
+  const int sources = 64;
+  for (int i = 1; i <= sources; ++i) {
+    if (!sendFrom(0x7f000000 + i, to)) {
+      std::cerr << "FAIL: cannot send from 127.0.0." << i << std::endl;
+      stop = 1;
+      first_worker.join();
+      second_worker.join();
+      return 1;
+    }
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  stop = 1;
+  first_worker.join();
+  second_worker.join();
+  close(receiver);
+
+  const uint64_t a = first.stats().packets;
+  const uint64_t b = second.stats().packets;
+  std::cout << "worker packets: " << a << " " << b << std::endl;
+  if (a + b < sources) {
+    std::cerr << "FAIL: packets lost" << std::endl;
+    return 1;
+  }
+  if (a == 0 || b == 0) {
+    std::cerr << "FAIL: fanout sent all sources to one worker" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,57 @@
+// Алерт со временем раньше последнего события инцидента (expire уже
+// сдвинул его до часов системы) сливается, а не выдаёт обновление.
+#include "incidenttable.h"
+#include <iostream>
+
+static firewall::AttackInfo alert(time_t timestamp) {
+  firewall::AttackInfo attack;
+  attack.type = attackName(ATTACK_SYN_FLOOD);
+  attack.source_ip = "10.0.0.1";
+  attack.count = 100;
+  attack.timestamp = timestamp;
+  attack.ip = 0x0100000a;
+  attack.kind = ATTACK_SYN_FLOOD;
+  return attack;
+}
+
+static size_t count(const std::vector<incidenttable::Event> &events,
+                    incidenttable::Phase phase) {
+  size_t n = 0;
+  for (const auto &event : events) {
+    n += event.phase == phase;
+  }
+  return n;
+}
+
+int main() {
+  IncidentConfig config;
+  config.update_interval = 10;
+  config.close_after = 60;
+  incidenttable incidents(config);
+  std::vector<incidenttable::Event> events;
+
+  incidents.observe(alert(1000), events);
+  incidents.observe(alert(1001), events); // отложенное обновление
+  incidents.expire(1020, events);         // emitted = 1020
+  if (count(events, incidenttable::Phase::OPEN) != 1 ||
+      count(events, incidenttable::Phase::UPDATE) != 1) {
+    std::cerr << "FAIL: expected open and deferred update" << std::endl;
+    return 1;
+  }
+
+  events.clear();
+  incidents.observe(alert(1015), events); // запоздал за emitted
+  incidents.observe(alert(1025), events);
+  if (!events.empty() || incidents.merged() != 3) {
+    std::cerr << "FAIL: late alert produced " << events.size()
+              << " events, merged " << incidents.merged() << std::endl;
+    return 1;
+  }
+
+  incidents.observe(alert(1030), events);
+  if (count(events, incidenttable::Phase::UPDATE) != 1) {
+    std::cerr << "FAIL: no update after update_interval" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,113 @@
+// Свёртка префиксов в nftables: /16, накрывший стоящие /24, должен
+// встать в интервальный набор, а повторный ban - перезапустить timeout.
+// Ядро заменено моделью наборов: транзакция применяется целиком или
+// никак, пересечение интервалов и delete отсутствующего - ошибка.
+#include "nftmitigator.h"
+#include <arpa/inet.h>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+
+class fakenft : public nftmitigator {
+public:
+  using Element = std::pair<uint32_t, uint8_t>; // порядок хоста, длина
+  using nftmitigator::Prefix;
+
+  explicit fakenft(const MitigationConfig &config) : nftmitigator(config) {}
+
+  void run(std::vector<Prefix> batch) { commit(batch); }
+
+  std::map<std::string, std::set<Element>> sets;
+  size_t deletes = 0;
+
+protected:
+  bool execute(const std::string &commands) override {
+    auto next = sets;
+    size_t removed = 0;
+    std::istringstream lines(commands);
+    std::string line;
+    while (std::getline(lines, line)) {
+      std::istringstream words(line);
+      std::string verb, element, family, table, set, word;
+      words >> verb >> element >> family >> table >> set >> word;
+      while (words >> word && word != "}") {
+        if (word.back() == ',') {
+          word.pop_back();
+        }
+        if (!apply(next[set], verb, word, set.ends_with("_net"))) {
+          return false;
+        }
+        removed += verb == "delete";
+      }
+    }
+    sets.swap(next);
+    deletes += removed;
+    return true;
+  }
+
+private:
+  static bool apply(std::set<Element> &set, const std::string &verb,
+                    const std::string &text, bool interval) {
+    const size_t slash = text.find('/');
+    in_addr address;
+    inet_pton(AF_INET, text.substr(0, slash).c_str(), &address);
+    const int length =
+        slash == std::string::npos ? 32 : std::stoi(text.substr(slash + 1));
+    const Element element{ntohl(address.s_addr), uint8_t(length)};
+    if (verb == "delete") {
+      return set.erase(element) == 1;
+    }
+    if (set.count(element)) {
+      return true; // add существующего - не ошибка и не продление
+    }
+    if (interval) {
+      for (const Element &other : set) {
+        const uint8_t length = std::min(other.second, element.second);
+        const uint32_t mask = length ? ~0u << (32 - length) : 0;
+        if ((other.first & mask) == (element.first & mask)) {
+          return false; // conflicting intervals
+        }
+      }
+    }
+    set.insert(element);
+    return true;
+  }
+};
+
+static fakenft::Prefix prefix(const char *text, uint8_t length) {
+  in_addr address;
+  inet_pton(AF_INET, text, &address);
+  return {address.s_addr, length};
+}
+
+static bool check(bool ok, const char *what) {
+  if (!ok) {
+    std::cerr << "FAIL: " << what << std::endl;
+  }
+  return ok;
+}
+
+int main() {
+  MitigationConfig config;
+  config.timeout = 600;
+  fakenft nft(config);
+  const fakenft::Element slash16{0x0a010000, 16};
+
+  nft.run({prefix("10.1.1.0", 24), prefix("10.1.2.0", 24),
+           prefix("10.0.0.5", 32)});
+  nft.run({prefix("10.1.0.0", 16)});
+  bool ok = check(nft.failures() == 0, "roll-up transaction failed") &&
+            check(nft.sets["blocked_net"] == std::set{slash16},
+                  "covered /24 left in the set");
+
+  nft.run({prefix("10.1.3.0", 24)});
+  ok = ok && check(nft.sets["blocked_net"] == std::set{slash16},
+                   "prefix under a live /16 added");
+
+  const size_t deletes = nft.deletes;
+  nft.run({prefix("10.1.0.0", 16), prefix("10.0.0.5", 32)});
+  ok = ok && check(nft.failures() == 0, "refresh failed") &&
+       check(nft.deletes == deletes + 2, "refresh did not re-add elements");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include "detectorclock.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Иерархическое колесо таймеров: 4 уровня по 64 слота, тик задаётся в
+// конструкторе (при тике в 1 с горизонт - около 194 суток, дальше
+// срок обрезается). Таймер - только ключ и тип, состояние владельца
+// колесо не хранит: обработчик сам смотрит, не продлилась ли жизнь
+// объекта, и при необходимости ставит таймер заново. Постановка - O(1),
+// срабатывание - O(1) амортизированно (каждый таймер спускается по
+// уровням не больше трёх раз).
+class timerwheel {
+public:
+  struct Timer {
+    uint64_t when; // в тиках
+    uint64_t key;
+    uint32_t kind;
+    uint32_t tag; // на усмотрение владельца, например поколение записи
+  };
+
+  explicit timerwheel(EventTime tick) : tick(tick) {}
+
+  size_t size() const { return count; }
+
+  // now нужен только первому вызову: от него колесо начинает отсчёт
+  void schedule(uint64_t key, uint32_t kind, EventTime deadline,
+                EventTime now, uint32_t tag = 0) {
+    start(now);
+    place({ticks(deadline), key, kind, tag});
+    ++count;
+  }
+
+  // Доводит колесо до now и вызывает expire для наступивших таймеров.
+  // За вызов обрабатывается не больше budget таймеров, остаток - в
+  // следующий раз: большая волна истечений не даёт пиков задержки.
+  template <typename Fn>
+  void advance(EventTime now, size_t budget, Fn expire) {
+    start(now);
+    uint64_t target = ticks(now);
+    if (count == 0) {
+      // Пустое колесо можно перевести сразу, без обхода пустых тиков
+      current = std::max(current, target);
+      return;
+    }
+
+    for (;;) {
+      std::vector<Timer> &slot = levels[0][current & slot_mask];
+      while (!slot.empty()) {
+        if (budget == 0) {
+          return;
+        }
+        --budget;
+        Timer timer = slot.back();
+        slot.pop_back();
+        --count;
+        expire(timer);
+      }
+
+      if (current >= target) {
+        return;
+      }
+      ++current;
+      cascade();
+    }
+  }
+
+private:
+  static constexpr int level_bits = 6;
+  static constexpr size_t slots_per_level = 1 << level_bits;
+  static constexpr uint64_t slot_mask = slots_per_level - 1;
+  static constexpr int level_count = 4;
+  static constexpr uint64_t horizon = uint64_t(1)
+                                      << (level_bits * level_count);
+
+  uint64_t ticks(EventTime t) const {
+    return uint64_t(std::max<EventTime>(t, 0)) / tick;
+  }
+
+  void start(EventTime now) {
+    if (!started) {
+      current = ticks(now);
+      started = true;
+    }
+  }
+
+  void place(Timer timer) {
+    if (timer.when < current) {
+      timer.when = current;
+    }
+    uint64_t delta = timer.when - current;
+    if (delta >= horizon) {
+      timer.when = current + horizon - 1;
+      delta = horizon - 1;
+    }
+
+    int level = 0;
+    while (delta >= (uint64_t(1) << (level_bits * (level + 1)))) {
+      ++level;
+    }
+    levels[level][(timer.when >> (level_bits * level)) & slot_mask].push_back(
+        timer);
+  }
+
+  // На границе периода уровня его текущий слот раскладывается по нижним
+  // уровням; сверху вниз, чтобы спущенные таймеры попали в свои слоты
+  void cascade() {
+    for (int level = level_count - 1; level > 0; --level) {
+      uint64_t period = uint64_t(1) << (level_bits * level);
+      if (current % period != 0) {
+        continue;
+      }
+      std::vector<Timer> &slot =
+          levels[level][(current >> (level_bits * level)) & slot_mask];
+      scratch.swap(slot);
+      for (const Timer &timer : scratch) {
+        place(timer);
+      }
+      scratch.clear();
+    }
+  }
+
+  EventTime tick;
+  uint64_t current = 0;
+  bool started = false;
+  size_t count = 0;
+  std::array<std::array<std::vector<Timer>, slots_per_level>, level_count>
+      levels;
+  std::vector<Timer> scratch;
+};
+
+#endif // TIMERWHEEL_H
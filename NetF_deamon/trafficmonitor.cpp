@@ -1,3 +1,256 @@
 #include "trafficmonitor.h"
+#include "bpfprefilter.h"
+#include "logger.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <iostream>
+#include <stdexcept>
+#include <unistd.h>
 
-trafficmonitor::trafficmonitor() {}
+trafficmonitor::trafficmonitor(const CaptureConfig &config,
+                               const DetectorConfig &detection,
+                               const AggregateConfig &aggregate)
+    : config(config), detection(detection), limits(detection),
+      alert_queue(std::make_shared<alertqueue>(detection.alert_queue)),
+      aggregator(aggregate, detection.block_ttl) {
+  if (this->config.workers == 0) {
+    this->config.workers = std::max(1u, std::thread::hardware_concurrency());
+  }
+  if (this->config.fanout_group == 0) {
+    this->config.fanout_group = getpid() & 0xffff;
+  }
+}
+
+trafficmonitor::~trafficmonitor() { join(); }
+
+void trafficmonitor::start(volatile sig_atomic_t &stop_flag) {
+  auto first = packetcapture::create(config);
+  if (!first) {
+    throw std::runtime_error("no capture backend available for " +
+                             config.interface);
+  }
+
+  // libpcap не умеет fanout - без кольца работаем в один поток
+  uint32_t count = first->supportsFanout() ? config.workers : 1;
+  // Бюджет делится поровну: fanout раздаёт воркерам равные доли
+  // источников
+  if (detection.memory_budget > 0) {
+    limits = firewall::fitBudget(detection, detection.memory_budget / count);
+  }
+
+  workers.push_back(std::make_unique<Worker>(limits));
+  workers.back()->capture = std::move(first);
+  for (uint32_t i = 1; i < count; ++i) {
+    auto capture = packetcapture::create(config);
+    if (!capture || !capture->supportsFanout()) {
+      std::cerr << "Failed to open capture worker " << i << ", running with "
+                << i << " workers" << std::endl;
+      break;
+    }
+    workers.push_back(std::make_unique<Worker>(limits));
+    workers.back()->capture = std::move(capture);
+  }
+
+  if (kernel) {
+    workers.front()->detector.setKernelCounters(std::move(kernel));
+  }
+
+  const bool event_time =
+      !config.replay_file.empty() || config.clock == "event";
+  for (auto &worker : workers) {
+    worker->detector.setFanout(workers.size());
+    worker->detector.setAlertQueue(alert_queue);
+    if (event_time) {
+      worker->detector.setClock(std::make_unique<eventclock>());
+    } else {
+      worker->detector.setClock(std::make_unique<coarseclock>());
+    }
+  }
+  setRules(rules);
+
+  std::cout << "Capturing on "
+            << (config.replay_file.empty() ? config.interface
+                                           : config.replay_file)
+            << " via "
+            << workers.front()->capture->name() << ", " << workers.size()
+            << " worker(s)" << std::endl;
+  if (detection.memory_budget > 0) {
+    std::cout << "Memory budget " << (detection.memory_budget >> 20)
+              << " MiB, per worker: " << limits.max_sources << " sources, "
+              << limits.max_scans << " scans, " << limits.max_targets
+              << " targets, " << limits.max_flows << " flows, "
+              << limits.max_blocked << " blocked" << std::endl;
+  }
+
+  for (auto &worker : workers) {
+    Worker *w = worker.get();
+    w->thread = std::thread([w, &stop_flag]() {
+      try {
+        w->capture->run(w->detector, stop_flag);
+        // Живой захват выходит только по stop_flag, replay - в конце файла
+        stop_flag = 1;
+      } catch (const std::exception &e) {
+        std::cerr << "Monitor error: " << e.what() << std::endl;
+        stop_flag = 1;
+      }
+    });
+  }
+}
+
+void trafficmonitor::setKernelCounters(
+    std::unique_ptr<kernelflood> counters) {
+  kernel = std::move(counters);
+}
+
+void trafficmonitor::setRules(std::shared_ptr<const ruletable> rules) {
+  this->rules = rules;
+  // Выключенные при сборке детекторы префильтр не пропускает; в
+  // конвейере их и так нет. Флуд в режиме kernel считается в ядре.
+  uint32_t detectors = rules->detectors() & firewall::supportedDetectors();
+  if (detection.flood_mode == "kernel") {
+    for (Detector flood : flood_detectors) {
+      detectors &= ~flood;
+    }
+  }
+  for (auto &worker : workers) {
+    worker->detector.setRules(rules);
+    if (config.prefilter) {
+      worker->capture->setFilter(
+          bpfprefilter::build(detectors, config.snaplen));
+    }
+  }
+}
+
+void trafficmonitor::join() {
+  for (auto &worker : workers) {
+    if (worker->thread.joinable()) {
+      worker->thread.join();
+    }
+  }
+}
+
+static firewall::AttackInfo subnetAttack(const prefixaggregator::Prefix &prefix,
+                                         uint32_t seconds) {
+  char network[INET_ADDRSTRLEN];
+  inet_ntop(AF_INET, &prefix.network, network, sizeof(network));
+  firewall::AttackInfo attack = {
+      attackName(ATTACK_SUBNET),
+      std::string(network) + "/" + std::to_string(prefix.length),
+      int(prefix.members), seconds, prefix.network};
+  attack.kind = ATTACK_SUBNET;
+  attack.length = prefix.length;
+  return attack;
+}
+
+static firewall::AttackInfo attackInfo(const AlertRecord &record) {
+  char address[INET_ADDRSTRLEN];
+  inet_ntop(AF_INET, &record.ip, address, sizeof(address));
+  firewall::AttackInfo attack = {attackName(record.type), address,
+                                 int(record.count), record.timestamp,
+                                 record.ip, record.target};
+  attack.kind = record.type;
+  attack.length = record.length;
+  return attack;
+}
+
+// Очередь выбирается пачками до пустой; записи, пришедшие во время
+// разбора, достанутся следующему пробуждению
+std::vector<firewall::AttackInfo> trafficmonitor::collectAttacks() {
+  std::vector<firewall::AttackInfo> detected;
+  AlertRecord batch[256];
+  while (size_t count = alert_queue->drain(batch, std::size(batch))) {
+    for (size_t i = 0; i < count; ++i) {
+      detected.push_back(attackInfo(batch[i]));
+    }
+  }
+
+  const size_t known = blocked.size();
+  for (auto &worker : workers) {
+    auto sources = worker->detector.takeBlockedSources();
+    blocked.insert(blocked.end(), sources.begin(), sources.end());
+  }
+
+  // Время агрегатора - время событий: в replay оно идёт по файлу
+  uint32_t latest = 0;
+  std::vector<firewall::AttackInfo> attacks;
+  std::vector<firewall::BlockInfo> activated;
+  for (size_t i = known; i < blocked.size(); ++i) {
+    const firewall::BlockInfo &source = blocked[i];
+    latest = std::max(latest, source.since);
+    prefixaggregator::Prefix prefix;
+    if (aggregator.addMember(source.ip, source.since, prefix)) {
+      logger::log(LogLevel::WARN, LogEvent::SUBNET_ATTACK, prefix.network,
+                  prefix.length, prefix.members);
+      attacks.push_back(subnetAttack(prefix, source.since));
+      activated.push_back({prefix.network, source.since, prefix.length});
+    } else if (aggregator.refresh(source.ip, source.since, prefix)) {
+      activated.push_back({prefix.network, source.since, prefix.length});
+    }
+  }
+  blocked.insert(blocked.end(), activated.begin(), activated.end());
+  for (const auto &attack : detected) {
+    latest = std::max<uint32_t>(latest, attack.timestamp);
+  }
+  if (latest > 0) {
+    aggregator.expire(latest);
+  }
+
+  for (auto &attack : detected) {
+    prefixaggregator::Prefix prefix;
+    if (!attack.target && aggregator.covering(attack.ip, prefix)) {
+      continue;
+    }
+    attacks.push_back(std::move(attack));
+  }
+  return attacks;
+}
+
+std::vector<firewall::BlockInfo> trafficmonitor::takeBlockedSources() {
+  std::vector<firewall::BlockInfo> taken;
+  taken.swap(blocked);
+  return taken;
+}
+
+uint64_t
+trafficmonitor::sum(std::atomic<uint64_t> firewall::Counters::*counter) const {
+  uint64_t total = 0;
+  for (const auto &worker : workers) {
+    total += (worker->detector.counters().*counter)
+                 .load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+uint64_t trafficmonitor::totalPackets() const {
+  return sum(&firewall::Counters::packets);
+}
+
+uint64_t trafficmonitor::untrackedPackets() const {
+  return sum(&firewall::Counters::table_full);
+}
+
+uint64_t trafficmonitor::untrackedTargets() const {
+  return sum(&firewall::Counters::targets_full);
+}
+
+uint64_t trafficmonitor::untrackedFlows() const {
+  return sum(&firewall::Counters::flows_full);
+}
+
+uint64_t trafficmonitor::allowedPackets() const {
+  return sum(&firewall::Counters::allowed);
+}
+
+uint64_t trafficmonitor::deniedPackets() const {
+  return sum(&firewall::Counters::denied);
+}
+
+CaptureStats trafficmonitor::captureStats() {
+  CaptureStats total;
+  for (auto &worker : workers) {
+    CaptureStats part = worker->capture->stats();
+    total.packets += part.packets;
+    total.drops += part.drops;
+  }
+  return total;
+}
@@ -2,33 +2,77 @@
 #define TRAFFICMONITOR_H
 
 #include "firewall.h"
-#include <pcap.h>
-#include <string>
+#include "packetcapture.h"
+#include "prefixaggregator.h"
+#include <csignal>
+#include <memory>
+#include <thread>
+#include <vector>
 
+// Пул воркеров захвата. Каждый воркер - свой сокет в общей fanout-группе,
+// свой поток и свой экземпляр firewall; горячий путь без блокировок.
+// Алерты и счётчики собираются отсюда по медленному пути.
 class trafficmonitor {
 public:
-  trafficmonitor();
+  trafficmonitor(const CaptureConfig &config,
+                 const DetectorConfig &detection = DetectorConfig(),
+                 const AggregateConfig &aggregate = AggregateConfig());
+  ~trafficmonitor();
 
-  static void monitorTraffic(const std::string &interface) {
-    char errbuf[PCAP_ERRBUF_SIZE];
-    pcap_t *handle = pcap_open_live(interface.c_str(), 65536, 1, 5000, errbuf);
+  void start(volatile sig_atomic_t &stop_flag);
+  void join();
 
-    if (!handle) {
-      std::cerr << "PCAP error: " << errbuf << std::endl;
-      return;
-    }
+  // Публикует новую таблицу правил во всех воркерах и пересобирает
+  // BPF-префильтр под объединённый набор детекторов; захват не
+  // останавливается
+  void setRules(std::shared_ptr<const ruletable> rules);
+  // Режим flood_mode = "kernel": загруженные счётчики отдаются первому
+  // воркеру при start
+  void setKernelCounters(std::unique_ptr<kernelflood> counters);
 
-    struct pcap_pkthdr header;
-    while (true) {
-      const u_char *packet = pcap_next(handle, &header);
-      if (!packet)
-        continue;
+  // Алерты всех воркеров. Заблокированные адреса сворачиваются в
+  // префиксы: алерты источников под активным префиксом заменяются одним
+  // алертом о подсети.
+  std::vector<firewall::AttackInfo> collectAttacks();
+  // Общая очередь алертов: её eventfd будит главный цикл
+  alertqueue &alerts() { return *alert_queue; }
+  uint64_t droppedAlerts() const { return alert_queue->dropped(); }
+  // Адреса, впервые попавшие в пул блокировки с прошлого вызова, и
+  // включившиеся префиксы; пополняется в collectAttacks
+  std::vector<firewall::BlockInfo> takeBlockedSources();
+  const prefixaggregator &prefixes() const { return aggregator; }
+  uint64_t totalPackets() const;
+  uint64_t untrackedPackets() const; // не нашлось места в таблице источников
+  uint64_t untrackedTargets() const; // то же для таблицы адресов назначения
+  uint64_t untrackedFlows() const;   // SYN без места в таблице потоков
+  uint64_t allowedPackets() const;
+  uint64_t deniedPackets() const;
+  CaptureStats captureStats(); // только после join()
+  size_t workerCount() const { return workers.size(); }
+  // Сумма счётчика по воркерам, например &firewall::Counters::evictions
+  uint64_t sum(std::atomic<uint64_t> firewall::Counters::*counter) const;
+  // Размеры таблиц одного воркера после раздела бюджета памяти
+  const DetectorConfig &workerLimits() const { return limits; }
 
-      firewall::analyzePacket(packet, &header);
-    }
+private:
 
-    pcap_close(handle);
-  }
+  struct Worker {
+    explicit Worker(const DetectorConfig &detection) : detector(detection) {}
+
+    firewall detector;
+    std::unique_ptr<packetcapture> capture;
+    std::thread thread;
+  };
+
+  CaptureConfig config;
+  DetectorConfig detection;
+  DetectorConfig limits;
+  std::shared_ptr<const ruletable> rules = std::make_shared<const ruletable>();
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::shared_ptr<alertqueue> alert_queue;
+  std::unique_ptr<kernelflood> kernel; // до start
+  prefixaggregator aggregator; // только поток, вызывающий collectAttacks
+  std::vector<firewall::BlockInfo> blocked; // тот же поток
 };
 
 #endif // TRAFFICMONITOR_H
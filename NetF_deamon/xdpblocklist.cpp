@@ -0,0 +1,190 @@
+#include "xdpblocklist.h"
+#include "ebpf.h"
+#include "logger.h"
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <linux/if_link.h>
+#include <net/ethernet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+xdpblocklist::xdpblocklist(const XdpConfig &config) : config(config) {}
+
+xdpblocklist::~xdpblocklist() { detach(); }
+
+uint64_t xdpblocklist::monotonicNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+// Ethernet + IPv4: ищем источник в карте, живую запись считаем и
+// отбрасываем, остальное отдаём следующей программе цепочки или
+// пропускаем дальше в стек и захват
+int xdpblocklist::buildProgram(std::string &log) {
+  using e = ebpf;
+  std::vector<bpf_insn> code;
+  std::vector<size_t> to_pass; // переходы на XDP_PASS
+
+  const uint32_t saddr = sizeof(struct ether_header) + 12;
+  code.push_back(e::mov(BPF_REG_9, BPF_REG_1));
+  code.push_back(e::load(BPF_W, BPF_REG_2, BPF_REG_1, 0)); // data
+  code.push_back(e::load(BPF_W, BPF_REG_3, BPF_REG_1, 4)); // data_end
+  code.push_back(e::mov(BPF_REG_4, BPF_REG_2));
+  code.push_back(e::aluImm(BPF_ADD, BPF_REG_4, saddr + 4));
+  to_pass.push_back(code.size());
+  code.push_back(e::jumpReg(BPF_JGT, BPF_REG_4, BPF_REG_3, 0));
+  code.push_back(e::load(BPF_H, BPF_REG_4, BPF_REG_2, 12));
+  to_pass.push_back(code.size());
+  code.push_back(e::jumpImm(BPF_JNE, BPF_REG_4, htons(ETHERTYPE_IP), 0));
+
+  // Ключ {32, saddr} на стеке
+  code.push_back(e::load(BPF_W, BPF_REG_4, BPF_REG_2, saddr));
+  code.push_back(e::storeImm(BPF_W, BPF_REG_10, -8, 32));
+  code.push_back(e::store(BPF_W, BPF_REG_10, BPF_REG_4, -4));
+  e::loadMap(code, BPF_REG_1, map);
+  code.push_back(e::mov(BPF_REG_2, BPF_REG_10));
+  code.push_back(e::aluImm(BPF_ADD, BPF_REG_2, -8));
+  code.push_back(e::call(BPF_FUNC_map_lookup_elem));
+  to_pass.push_back(code.size());
+  code.push_back(e::jumpImm(BPF_JEQ, BPF_REG_0, 0, 0));
+
+  code.push_back(e::mov(BPF_REG_6, BPF_REG_0));
+  code.push_back(e::call(BPF_FUNC_ktime_get_ns));
+  code.push_back(e::load(BPF_DW, BPF_REG_1, BPF_REG_6,
+                         offsetof(Entry, expires_ns)));
+  to_pass.push_back(code.size());
+  code.push_back(e::jumpReg(BPF_JGT, BPF_REG_0, BPF_REG_1, 0));
+  code.push_back(e::movImm(BPF_REG_1, 1));
+  code.push_back(
+      e::atomicAdd(BPF_DW, BPF_REG_6, BPF_REG_1, offsetof(Entry, drops)));
+  code.push_back(e::movImm(BPF_REG_0, XDP_DROP));
+  code.push_back(e::exit());
+
+  // Пустой слот цепочки - tail call не выполняется и идём дальше
+  const size_t pass = code.size();
+  code.push_back(e::mov(BPF_REG_1, BPF_REG_9));
+  e::loadMap(code, BPF_REG_2, chain_map);
+  code.push_back(e::movImm(BPF_REG_3, 0));
+  code.push_back(e::call(BPF_FUNC_tail_call));
+  code.push_back(e::movImm(BPF_REG_0, XDP_PASS));
+  code.push_back(e::exit());
+  for (size_t at : to_pass) {
+    code[at].off = pass - at - 1;
+  }
+  return ebpf::loadProgram(BPF_PROG_TYPE_XDP, BPF_XDP, code, "netf_block",
+                           log);
+}
+
+bool xdpblocklist::attach(const std::string &interface) {
+  const int ifindex = if_nametoindex(interface.c_str());
+  if (ifindex == 0) {
+    std::cerr << "XDP: unknown interface " << interface << std::endl;
+    return false;
+  }
+  map = ebpf::createMap(BPF_MAP_TYPE_LPM_TRIE, sizeof(Key), sizeof(Entry),
+                        config.max_entries, BPF_F_NO_PREALLOC, "netf_block");
+  chain_map = ebpf::createMap(BPF_MAP_TYPE_PROG_ARRAY, sizeof(uint32_t),
+                              sizeof(uint32_t), 1, 0, "netf_chain");
+  if (map < 0 || chain_map < 0) {
+    std::cerr << "XDP: failed to create map: " << strerror(errno)
+              << std::endl;
+    detach();
+    return false;
+  }
+  std::string log;
+  program = buildProgram(log);
+  if (program < 0) {
+    std::cerr << "XDP: program rejected: " << strerror(errno) << "\n"
+              << log << std::endl;
+    detach();
+    return false;
+  }
+  const uint32_t flags =
+      config.mode == "native" ? XDP_FLAGS_DRV_MODE : XDP_FLAGS_SKB_MODE;
+  link = ebpf::attachXdp(program, ifindex, flags);
+  if (link < 0) {
+    std::cerr << "XDP: failed to attach to " << interface << ": "
+              << strerror(errno) << std::endl;
+    detach();
+    return false;
+  }
+  return true;
+}
+
+void xdpblocklist::detach() {
+  for (int *fd : {&link, &program, &chain_map, &map}) {
+    if (*fd >= 0) {
+      close(*fd);
+      *fd = -1;
+    }
+  }
+  entries.clear();
+}
+
+bool xdpblocklist::chain(int next) {
+  const uint32_t slot = 0;
+  if (chain_map < 0 || !ebpf::update(chain_map, &slot, &next)) {
+    std::cerr << "XDP: failed to chain program: " << strerror(errno)
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// Продление сохраняет счётчик; инкременты программы между чтением и
+// записью значения теряются, для статистики это допустимо
+bool xdpblocklist::block(uint32_t network, uint8_t length, uint32_t ttl) {
+  if (map < 0) {
+    return false;
+  }
+  const uint64_t id = uint64_t(length) << 32 | network;
+  Key key{length, network};
+  Entry value{monotonicNs() + uint64_t(ttl) * 1000000000ULL, 0};
+  auto it = entries.find(id);
+  if (it != entries.end()) {
+    Entry current;
+    if (ebpf::lookup(map, &key, &current)) {
+      value.drops = current.drops;
+    }
+  }
+  if (!ebpf::update(map, &key, &value)) {
+    rejected_count++;
+    return false;
+  }
+  if (it == entries.end()) {
+    entries.emplace(id, value);
+  } else {
+    it->second.expires_ns = value.expires_ns;
+  }
+  return true;
+}
+
+void xdpblocklist::refresh() {
+  const uint64_t now = monotonicNs();
+  uint64_t dropped = 0;
+  for (auto it = entries.begin(); it != entries.end();) {
+    Key key{uint32_t(it->first >> 32), uint32_t(it->first)};
+    Entry value;
+    if (ebpf::lookup(map, &key, &value)) {
+      dropped += value.drops - it->second.drops;
+      it->second.drops = value.drops;
+    }
+    if (it->second.expires_ns > now) {
+      ++it;
+      continue;
+    }
+    ebpf::erase(map, &key);
+    logger::log(LogLevel::INFO, LogEvent::XDP_EXPIRED, key.network,
+                key.length, it->second.drops);
+    it = entries.erase(it);
+  }
+  total_drops += dropped;
+  if (dropped > 0) {
+    logger::log(LogLevel::INFO, LogEvent::XDP_DROPS, dropped,
+                entries.size());
+  }
+}
@@ -0,0 +1,75 @@
+#ifndef XDPBLOCKLIST_H
+#define XDPBLOCKLIST_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+struct XdpConfig {
+  bool enabled = false;
+  // generic - XDP в стеке (работает на veth и lo), native - в драйвере
+  std::string mode = "generic";
+  uint32_t max_entries = 65536; // префиксов в карте
+};
+
+// XDP-программа, отбрасывающая пакеты заблокированных источников до
+// захвата: забаненный источник больше не стоит ни копирования в
+// кольцо, ни analyzePacket. Источники лежат в LPM-карте (адреса /32 и
+// свёрнутые префиксы), у каждой записи срок в CLOCK_MONOTONIC и счётчик
+// отброшенных пакетов. Истёкшая запись перестаёт действовать сразу, а
+// из карты её убирает refresh.
+class xdpblocklist {
+public:
+  // Значение в карте; drops программа увеличивает атомарно
+  struct Entry {
+    uint64_t expires_ns;
+    uint64_t drops;
+  };
+
+  explicit xdpblocklist(const XdpConfig &config);
+  ~xdpblocklist();
+
+  bool attach(const std::string &interface);
+  void detach();
+  // На интерфейсе одна XDP-программа: next выполняется для пропущенных
+  // пакетов хвостовым вызовом (kernelflood)
+  bool chain(int next);
+
+  // Добавляет или продлевает блокировку; network в сетевом порядке
+  bool block(uint32_t network, uint8_t length, uint32_t ttl);
+  // Перечитывает счётчики и удаляет истёкшие записи; раз в секунду
+  void refresh();
+
+  size_t size() const { return entries.size(); }
+  uint64_t drops() const { return total_drops; }
+  uint64_t rejected() const { return rejected_count; }
+
+  // fn(network, length, drops) - текущие записи по последнему refresh
+  template <typename Fn> void forEach(Fn fn) const {
+    for (const auto &[key, entry] : entries) {
+      fn(uint32_t(key), uint8_t(key >> 32), entry.drops);
+    }
+  }
+
+private:
+  // Ключ LPM-карты: длина префикса и адрес в сетевом порядке
+  struct Key {
+    uint32_t length;
+    uint32_t network;
+  };
+
+  static uint64_t monotonicNs();
+  int buildProgram(std::string &log);
+
+  XdpConfig config;
+  int map = -1;
+  int chain_map = -1; // BPF_MAP_TYPE_PROG_ARRAY из одного слота
+  int program = -1;
+  int link = -1;
+  // Копия карты: длина << 32 | сеть -> срок и счётчик последнего чтения
+  std::map<uint64_t, Entry> entries;
+  uint64_t total_drops = 0; // с учётом удалённых записей
+  uint64_t rejected_count = 0;
+};
+
+#endif // XDPBLOCKLIST_H
@@ -1,3 +0,0 @@
-#include "firewall.h"
-
-firewall::firewall() {}
@@ -9,8 +9,12 @@
 #include <QtCharts/QBarCategoryAxis>
 #include <QStringList>
 #include <QDateTime>
+#include <QDBusArgument>
 #include <QDBusConnection>
 #include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QPointer>
 #include <QTableWidget>
 #include <QHeaderView>
 #include <QPushButton>
@@ -58,19 +62,62 @@ void MainWindow::setupDBusConnection()
         return;
     }
 
+    // Демон шлёт алерты и пачкой AttacksDetected, и по одному
+    // AttackDetected: подписка на оба удвоила бы счётчики
     bool connected = QDBusConnection::sessionBus().connect(
         "com.netf.daemon",
         "/com/netf/daemon",
         "com.netf.daemon",
-        "AttackDetected",
+        "AttacksDetected",
         this,
-        SLOT(handleAttackDetected(QString,QString,int)));
+        SLOT(handleAttacksDetected(QDBusMessage)));
 
     if (!connected) {
-        qWarning("Failed to connect to AttackDetected signal.");
+        qWarning("Failed to connect to AttacksDetected signal.");
     }
 }
 
+// AttacksDetected(a(uuiqt)): тип (AttackType демона), IPv4 в порядке
+// хоста, счётчик, длина префикса, время алерта
+void MainWindow::handleAttacksDetected(const QDBusMessage &message)
+{
+    // Порядок - как в enum AttackType (alertqueue.h)
+    static const QStringList names = {
+        "UDP flood", "ICMP flood", "SYN flood", "FIN flood",
+        "Null Scan", "Xmas Scan", "Target under attack",
+        "Half-open flood", "Subnet attack", "Port Scan", "Host Scan",
+        "SSH connect flood", "SSH bruteforce"};
+
+    if (message.arguments().isEmpty()) {
+        return;
+    }
+    const QDBusArgument records =
+        message.arguments().first().value<QDBusArgument>();
+    records.beginArray();
+    while (!records.atEnd()) {
+        quint32 type = 0;
+        quint32 ip = 0;
+        qint32 count = 0;
+        quint16 length = 32;
+        quint64 timestamp = 0;
+        records.beginStructure();
+        records >> type >> ip >> count >> length >> timestamp;
+        records.endStructure();
+
+        QString address = QString("%1.%2.%3.%4")
+                              .arg(ip >> 24)
+                              .arg((ip >> 16) & 0xff)
+                              .arg((ip >> 8) & 0xff)
+                              .arg(ip & 0xff);
+        if (length < 32) {
+            address += QString("/%1").arg(length);
+        }
+        handleAttackDetected(names.value(type, "Unknown attack"), address,
+                             count);
+    }
+    records.endArray();
+}
+
 void MainWindow::handleAttackDetected(const QString &type, const QString &source_ip, int count)
 {
     QDateTime currentTime = QDateTime::currentDateTime();
@@ -101,8 +148,25 @@ void MainWindow::handleAttackDetected(const QString &type, const QString &source
         attackersTable->setItem(row, 2, new QTableWidgetItem(QString::number(count)));
 
         QPushButton *banButton = new QPushButton("Ban");
-        connect(banButton, &QPushButton::clicked, [this, source_ip]() {
-            qDebug() << "Ban IP:" << source_ip;
+        connect(banButton, &QPushButton::clicked, [this, source_ip, banButton]() {
+            // Демон добавляет адрес в свой набор nftables
+            QDBusMessage call = QDBusMessage::createMethodCall(
+                "com.netf.daemon", "/com/netf/daemon", "com.netf.daemon", "Ban");
+            call << source_ip;
+            auto *watcher = new QDBusPendingCallWatcher(
+                QDBusConnection::sessionBus().asyncCall(call), this);
+            QPointer<QPushButton> button(banButton);
+            connect(watcher, &QDBusPendingCallWatcher::finished, this,
+                    [source_ip, button](QDBusPendingCallWatcher *watcher) {
+                QDBusPendingReply<> reply = *watcher;
+                if (reply.isError()) {
+                    qWarning() << "Ban" << source_ip << "failed:" << reply.error().message();
+                } else if (button) {
+                    button->setText("Banned");
+                    button->setEnabled(false);
+                }
+                watcher->deleteLater();
+            });
         });
         attackersTable->setCellWidget(row, 3, banButton);
     }
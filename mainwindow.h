@@ -13,6 +13,7 @@
 #include <QLabel>
 #include <QtDBus/QDBusConnection>
 #include <QtDBus/QDBusInterface>
+#include <QtDBus/QDBusMessage>
 
 #include <QtCharts>
 
@@ -40,6 +41,7 @@ private slots:
     void updateCharts();
     void showAttackDetails();
     void handleAttackDetected(const QString &type, const QString &source_ip, int count);
+    void handleAttacksDetected(const QDBusMessage &message);
 
 private:
     Ui::MainWindow *ui;